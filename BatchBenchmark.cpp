@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "Searcher.h"
+#include "BatchSearcher.h"
+
+using namespace JPS;
+
+/*
+	Scaling benchmark of BatchSearcher: times a batch of random queries on a grid of random boxes
+	with one Searcher calling FindPath in turn, then with FindPaths on 1 to N workers, and checks
+	that every worker count returns the paths FindPath does;
+	usage: BatchBenchmark [queries = 2000] [max workers = hardware threads] [repeats = 3];
+	it has a main of its own, so the project lists it excluded from the build
+*/
+
+static double Milliseconds(std::chrono::steady_clock::time_point from)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - from).count();
+}
+
+int main(int argc, char ** argv)
+{
+	const unsigned queries = argc > 1 ? unsigned(atoi(argv[1])) : 2000U;
+	const unsigned maxWorkers = argc > 2 ? unsigned(atoi(argv[2])) : std::max(std::thread::hardware_concurrency(), 1U);
+	const unsigned repeats = argc > 3 ? std::max(unsigned(atoi(argv[3])), 1U) : 3U;
+
+	// boxes rather than noise, so no query floods the grid around a maze
+	const unsigned X = 128U, Y = 128U, Z = 64U;
+	std::vector<int> cells(X * Y * Z, 1);
+	std::mt19937 random(12345U);
+	for (unsigned b = 0; b < 600U; ++b)
+	{
+		const unsigned x0 = random() % X, y0 = random() % Y, z0 = random() % Z, size = 2U + random() % 8U;
+		for (unsigned z = z0; z < std::min(Z, z0 + size); ++z)
+		{
+			for (unsigned y = y0; y < std::min(Y, y0 + size); ++y)
+			{
+				for (unsigned x = x0; x < std::min(X, x0 + size); ++x)
+				{
+					cells[(z * Y + y) * X + x] = 0;
+				}
+			}
+		}
+	}
+	FGrid g(X, Y, Z, cells.data());
+
+	std::vector<FPathQuery> batch;
+	while (batch.size() < queries)
+	{
+		const FPosition a(random() % X, random() % Y, random() % Z);
+		const FPosition b(random() % X, random() % Y, random() % Z);
+		if (g(a) && g(b))
+		{
+			batch.push_back(FPathQuery(a, b));
+		}
+	}
+
+	Searcher prototype(g);
+	std::vector<std::vector<FPosition>> expected(batch.size());
+	double serial = 0.0;
+	for (unsigned r = 0; r < repeats; ++r)
+	{
+		Searcher s(prototype);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			expected[i] = s.FindPath(batch[i].start, batch[i].finish);
+		}
+		const double ms = Milliseconds(start);
+		serial = r ? std::min(serial, ms) : ms;
+	}
+	printf("grid %ux%ux%u, %u queries, best of %u runs\n", X, Y, Z, queries, repeats);
+	printf("FindPath     %9.1f ms\n", serial);
+
+	for (unsigned workers = 1U; workers <= maxWorkers; ++workers)
+	{
+		BatchSearcher batcher(prototype, workers);
+		std::vector<std::vector<FPosition>> results;
+		double best = 0.0;
+		size_t steals = 0U;
+		for (unsigned r = 0; r < repeats; ++r)
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			batcher.FindPaths(batch, results);
+			const double ms = Milliseconds(start);
+			best = r ? std::min(best, ms) : ms;
+			steals += batcher.GetSteals();
+		}
+		const bool same = results == expected;
+		printf("FindPaths %2u %9.1f ms  speedup %5.2f  steals/batch %6.1f  %s\n", workers, best, serial / best,
+			double(steals) / repeats, same ? "same paths" : "PATHS DIFFER");
+		if (!same)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
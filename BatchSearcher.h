@@ -0,0 +1,251 @@
+#ifndef BATCH_SEARCHER_H
+#define BATCH_SEARCHER_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "Directions.h"
+#include "Position.h"
+#include "Searcher.h"
+
+namespace JPS {
+
+	struct FPathQuery
+	{
+		FPathQuery() {}
+		FPathQuery(const FPosition & s, const FPosition & f) : start(s), finish(f) {}
+
+		FPosition start, finish;
+	};
+
+	/*
+		Runs batches of FindPath queries on a pool of workers that live as long as the object, each with its own Searcher,
+		a copy of the prototype, so the search contexts are reused from batch to batch. A batch is ordered by the estimated cost
+		of its queries, the longest first, and dealt out to the workers in turn; a worker takes its own queries from the front
+		and, once it has none left, steals the cheapest ones from the back of the others, so no worker idles while a long query runs;
+		BatchBenchmark.cpp times it against FindPath for 1 to N workers
+	*/
+	class BatchSearcher
+	{
+
+	public:
+
+		// threads == 0 uses every hardware thread; the calling thread is one of the workers
+		BatchSearcher(const Searcher & Prototype, unsigned threads = 0U);
+
+		~BatchSearcher();
+
+		BatchSearcher(const BatchSearcher &) = delete;
+		BatchSearcher & operator=(const BatchSearcher &) = delete;
+
+		/*
+			Finds the paths of Count queries, Results[i] receives the same values as Searcher::FindPath returns for Queries[i];
+			the queries run in parallel, so the grid and the structures the prototype reads must not change meanwhile
+		*/
+		void FindPaths(const FPathQuery * Queries, std::vector<FPosition> * Results, size_t Count);
+
+		inline void FindPaths(const std::vector<FPathQuery> & Queries, std::vector<std::vector<FPosition>> & Results)
+		{
+			Results.resize(Queries.size());
+			FindPaths(Queries.data(), Results.data(), Queries.size());
+		}
+
+		// hands new settings to every worker, between the batches
+		inline void SetPrototype(const Searcher & Prototype)
+		{
+			for (unsigned i = 0; i < workers.size(); ++i)
+			{
+				workers[i]->searcher = Prototype;
+			}
+		}
+
+		inline unsigned GetThreads() const
+		{
+			return unsigned(workers.size());
+		}
+
+		// queries the workers took from each other during the last batch
+		inline size_t GetSteals() const
+		{
+			return steals;
+		}
+
+	private:
+
+		struct FWorker
+		{
+			FWorker(const Searcher & s) : searcher(s) {}
+
+			Searcher searcher;
+			std::mutex lock;
+			std::deque<size_t> queue;
+			size_t steals = 0U;
+		};
+
+		std::vector<std::unique_ptr<FWorker>> workers;
+		std::vector<std::thread> threads;
+		std::mutex lock;
+		std::condition_variable wake, done;
+		// the batch the workers run, a new generation starts them
+		const FPathQuery * queries = NULL;
+		std::vector<FPosition> * results = NULL;
+		unsigned generation = 0U;
+		unsigned busy = 0U;
+		bool stop = false;
+		size_t steals = 0U;
+
+		void work(unsigned w);
+		bool take(unsigned w, size_t & q);
+		void loop(unsigned w);
+
+	};
+
+	inline BatchSearcher::BatchSearcher(const Searcher & Prototype, unsigned threads)
+	{
+		if (!threads)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+		}
+		for (unsigned w = 0; w < threads; ++w)
+		{
+			workers.push_back(std::unique_ptr<FWorker>(new FWorker(Prototype)));
+		}
+		// worker 0 is the calling thread
+		for (unsigned w = 1; w < threads; ++w)
+		{
+			this->threads.push_back(std::thread([this, w]() { loop(w); }));
+		}
+	}
+
+	inline BatchSearcher::~BatchSearcher()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
+		}
+		wake.notify_all();
+		for (unsigned t = 0; t < threads.size(); ++t)
+		{
+			threads[t].join();
+		}
+	}
+
+	inline void BatchSearcher::FindPaths(const FPathQuery * Queries, std::vector<FPosition> * Results, size_t Count)
+	{
+		if (!Count)
+		{
+			return;
+		}
+
+		// the longest queries first, the heuristic distance is the estimate
+		std::vector<std::pair<unsigned, size_t>> order(Count);
+		for (size_t i = 0; i < Count; ++i)
+		{
+			order[i] = std::make_pair(DirectionDistance(Queries[i].start, Queries[i].finish), i);
+		}
+		std::sort(order.begin(), order.end(), std::greater<std::pair<unsigned, size_t>>());
+		// a batch smaller than the pool deals nothing to some workers, their count of the last batch must go too
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			workers[w]->steals = 0U;
+		}
+		for (size_t i = 0; i < Count; ++i)
+		{
+			workers[i % workers.size()]->queue.push_back(order[i].second);
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queries = Queries;
+			results = Results;
+			busy = unsigned(threads.size());
+			++generation;
+		}
+		wake.notify_all();
+		work(0U);
+
+		// the results are only complete once every worker has left the batch
+		std::unique_lock<std::mutex> guard(lock);
+		done.wait(guard, [this]() { return busy == 0U; });
+		queries = NULL;
+		results = NULL;
+		steals = 0U;
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			steals += workers[w]->steals;
+		}
+	}
+
+	inline void BatchSearcher::loop(unsigned w)
+	{
+		unsigned seen = 0U;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				wake.wait(guard, [this, seen]() { return stop || generation != seen; });
+				if (stop)
+				{
+					return;
+				}
+				seen = generation;
+			}
+			work(w);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				--busy;
+			}
+			done.notify_one();
+		}
+	}
+
+	inline void BatchSearcher::work(unsigned w)
+	{
+		FWorker & wk = *workers[w];
+		size_t q;
+		while (take(w, q))
+		{
+			results[q] = wk.searcher.FindPath(queries[q].start, queries[q].finish);
+		}
+	}
+
+	// the next query of worker w: its own longest one, else the cheapest one of the next worker that has any
+	inline bool BatchSearcher::take(unsigned w, size_t & q)
+	{
+		FWorker & wk = *workers[w];
+		{
+			std::lock_guard<std::mutex> guard(wk.lock);
+			if (!wk.queue.empty())
+			{
+				q = wk.queue.front();
+				wk.queue.pop_front();
+				return true;
+			}
+		}
+		// the queues only shrink during a batch, so one round over them finds any query left
+		for (unsigned i = 1; i < workers.size(); ++i)
+		{
+			FWorker & victim = *workers[(w + i) % workers.size()];
+			std::lock_guard<std::mutex> guard(victim.lock);
+			if (!victim.queue.empty())
+			{
+				q = victim.queue.back();
+				victim.queue.pop_back();
+				++wk.steals;
+				return true;
+			}
+		}
+		return false;
+	}
+
+}
+
+#endif // !BATCH_SEARCHER_H
\ No newline at end of file
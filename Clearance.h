@@ -0,0 +1,279 @@
+#ifndef CLEARANCE_H
+#define CLEARANCE_H
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Chebyshev clearance of every voxel: the distance to the nearest blocked voxel or the grid border,
+		0 for blocked voxels and saturated at Cap, one byte per voxel; an agent of radius r, a cube of 2r + 1 voxels,
+		fits centred at a voxel exactly when its clearance is greater than r, so a search tests a footprint with one load.
+		The transform is separable: the distance along x, then the nearest cube of it along y and along z,
+		every pass parallel over the lines of the grid
+	*/
+	class Clearance
+	{
+
+	public:
+
+		// the clearance of agents of the passability classes Classes, the voxels free for none of them count as blocked
+		Clearance(const FGrid & g, unsigned Cap = 15U, int Classes = FGrid::AllClasses) : grid(g), cap(std::min(std::max(Cap, 1U), 255U)), classes(Classes) {}
+
+		// computes the whole grid, threads == 0 uses every hardware thread
+		void Build(unsigned threads = 0U);
+
+		// keeps the clearance valid after the cells at Changed have been edited in the grid; only the voxels within Cap of them are recomputed
+		void Update(const std::vector<FPosition> & Changed);
+
+		// 0 for blocked voxels and voxels outside the grid
+		inline unsigned Get(unsigned x, unsigned y, unsigned z) const
+		{
+			if (x < grid.x && y < grid.y && z < grid.z && !dist.empty())
+			{
+				return dist[index(x, y, z)];
+			}
+			return 0U;
+		}
+
+		inline unsigned Get(const FPosition & p) const
+		{
+			return Get(p.x, p.y, p.z);
+		}
+
+		// whether an agent of radius Radius fits centred at the voxel, Radius has to be less than the cap
+		inline bool Fits(unsigned x, unsigned y, unsigned z, unsigned Radius) const
+		{
+			return Get(x, y, z) > Radius;
+		}
+
+		// Fits without the bounds test, for callers that have done it; the transform has to be built
+		JPS_FORCEINLINE bool FitsInside(unsigned x, unsigned y, unsigned z, unsigned Radius) const
+		{
+			return dist[index(x, y, z)] > Radius;
+		}
+
+		inline unsigned GetCap() const
+		{
+			return cap;
+		}
+
+		inline int GetClasses() const
+		{
+			return classes;
+		}
+
+		inline void FreeMemory()
+		{
+			std::vector<uint8_t>().swap(dist);
+		}
+
+	private:
+
+		const FGrid & grid;
+		unsigned cap;
+		int classes;
+		std::vector<uint8_t> dist;
+
+		JPS_FORCEINLINE size_t index(unsigned x, unsigned y, unsigned z) const
+		{
+			return (size_t(z) * grid.y + y) * grid.x + x;
+		}
+
+		void compute(const FPosition & lo, const FPosition & hi, unsigned threads);
+
+		template <class TFunc>
+		static void parallelFor(unsigned count, unsigned threads, const TFunc & f);
+
+	};
+
+	inline void Clearance::Build(unsigned threads)
+	{
+		dist.assign(size_t(grid.x) * grid.y * grid.z, 0);
+		if (dist.empty())
+		{
+			return;
+		}
+		if (!threads)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+		}
+		compute(FPosition(0, 0, 0), FPosition(grid.x - 1, grid.y - 1, grid.z - 1), threads);
+	}
+
+	inline void Clearance::Update(const std::vector<FPosition> & Changed)
+	{
+		if (dist.empty())
+		{
+			return;
+		}
+
+		/*
+			An edit only changes the voxels closer to it than the cap, the others keep their value or stay saturated;
+			the boxes around the edits are merged until they are disjoint, so a wall recomputes one box
+		*/
+		std::vector<std::pair<FPosition, FPosition>> boxes;
+		const unsigned reach = cap - 1U;
+		for (unsigned i = 0; i < Changed.size(); ++i)
+		{
+			const FPosition & c = Changed[i];
+			if (c.x >= grid.x || c.y >= grid.y || c.z >= grid.z)
+			{
+				continue;
+			}
+			FPosition lo(c.x - std::min(c.x, reach), c.y - std::min(c.y, reach), c.z - std::min(c.z, reach));
+			FPosition hi(std::min(c.x + reach, grid.x - 1), std::min(c.y + reach, grid.y - 1), std::min(c.z + reach, grid.z - 1));
+			for (unsigned k = 0; k < boxes.size();)
+			{
+				const FPosition & blo = boxes[k].first;
+				const FPosition & bhi = boxes[k].second;
+				if (lo.x > bhi.x || lo.y > bhi.y || lo.z > bhi.z || hi.x < blo.x || hi.y < blo.y || hi.z < blo.z)
+				{
+					++k;
+					continue;
+				}
+				lo = FPosition(std::min(lo.x, blo.x), std::min(lo.y, blo.y), std::min(lo.z, blo.z));
+				hi = FPosition(std::max(hi.x, bhi.x), std::max(hi.y, bhi.y), std::max(hi.z, bhi.z));
+				boxes[k] = boxes.back();
+				boxes.pop_back();
+				// the grown box may reach a box it missed before
+				k = 0;
+			}
+			boxes.push_back(std::make_pair(lo, hi));
+		}
+
+		// disjoint boxes write disjoint parts of the transform, a single one is split over the threads instead
+		const unsigned threads = std::max(std::thread::hardware_concurrency(), 1U);
+		parallelFor(unsigned(boxes.size()), threads, [this, &boxes, threads](unsigned i)
+		{
+			compute(boxes[i].first, boxes[i].second, boxes.size() == 1 ? threads : 1U);
+		});
+	}
+
+	/*
+		Recomputes the box [lo, hi] from the voxels within the cap around it; the passes narrow down to the box
+		axis by axis, x first, so every pass only reads values the previous one has made exact
+	*/
+	inline void Clearance::compute(const FPosition & lo, const FPosition & hi, unsigned threads)
+	{
+		const FPosition dlo(lo.x - std::min(lo.x, cap), lo.y - std::min(lo.y, cap), lo.z - std::min(lo.z, cap));
+		const FPosition dhi(std::min(hi.x + cap, grid.x - 1), std::min(hi.y + cap, grid.y - 1), std::min(hi.z + cap, grid.z - 1));
+		const unsigned bx = hi.x - lo.x + 1;
+		const unsigned by = hi.y - lo.y + 1;
+		const unsigned dy = dhi.y - dlo.y + 1;
+		const unsigned dz = dhi.z - dlo.z + 1;
+		const unsigned c = cap;
+
+		// pass 1: the distance along x for the rows of the domain, the columns of the box
+		std::vector<uint8_t> alongX(size_t(bx) * dy * dz);
+		parallelFor(dy * dz, threads, [&](unsigned line)
+		{
+			const unsigned y = dlo.y + line % dy;
+			const unsigned z = dlo.z + line / dy;
+			std::vector<uint8_t> left(dhi.x - dlo.x + 1);
+			// past the domain the nearest blocked voxel is at least the cap away, past the grid it is right there
+			unsigned d = dlo.x == 0 ? 0U : c;
+			for (unsigned x = dlo.x; x <= dhi.x; ++x)
+			{
+				d = grid.IsPassable(x, y, z, classes) ? std::min(d + 1U, c) : 0U;
+				left[x - dlo.x] = uint8_t(d);
+			}
+			d = dhi.x == grid.x - 1 ? 0U : c;
+			for (unsigned x = dhi.x + 1; x-- > dlo.x;)
+			{
+				d = grid.IsPassable(x, y, z, classes) ? std::min(d + 1U, c) : 0U;
+				if (x >= lo.x && x <= hi.x)
+				{
+					alongX[size_t(line) * bx + (x - lo.x)] = uint8_t(std::min(d, unsigned(left[x - dlo.x])));
+				}
+			}
+		});
+
+		/*
+			The clearance of a line is the smallest r with a value of at most r within r of the voxel,
+			r is found growing the window both ways; past the grid the value is 0
+		*/
+		const auto nearest = [c](const uint8_t * line, unsigned size, unsigned stride, unsigned at) -> uint8_t
+		{
+			unsigned m = line[size_t(at) * stride];
+			for (unsigned r = 0; r < c; ++r)
+			{
+				if (m <= r)
+				{
+					return uint8_t(r);
+				}
+				const unsigned lower = at >= r + 1 ? line[size_t(at - r - 1) * stride] : 0U;
+				const unsigned upper = at + r + 1 < size ? line[size_t(at + r + 1) * stride] : 0U;
+				m = std::min(m, std::min(lower, upper));
+			}
+			return uint8_t(c);
+		};
+
+		// pass 2: along y for the slices of the domain, the rows of the box
+		std::vector<uint8_t> alongY(size_t(bx) * by * dz);
+		parallelFor(bx * dz, threads, [&](unsigned line)
+		{
+			const unsigned x = line % bx;
+			const unsigned z = line / bx;
+			const uint8_t * column = &alongX[size_t(z) * dy * bx + x];
+			for (unsigned y = lo.y; y <= hi.y; ++y)
+			{
+				alongY[(size_t(z) * by + (y - lo.y)) * bx + x] = nearest(column, dy, bx, y - dlo.y);
+			}
+		});
+
+		// pass 3: along z for the box; a domain edge inside the grid is never reached, it is the cap away
+		parallelFor(bx * by, threads, [&](unsigned line)
+		{
+			const unsigned x = line % bx;
+			const unsigned y = line / bx;
+			const uint8_t * column = &alongY[size_t(y) * bx + x];
+			for (unsigned z = lo.z; z <= hi.z; ++z)
+			{
+				dist[index(lo.x + x, lo.y + y, z)] = nearest(column, dz, bx * by, z - dlo.z);
+			}
+		});
+	}
+
+	template <class TFunc>
+	inline void Clearance::parallelFor(unsigned count, unsigned threads, const TFunc & f)
+	{
+		threads = std::min(threads, count);
+		if (threads <= 1U)
+		{
+			for (unsigned i = 0; i < count; ++i)
+			{
+				f(i);
+			}
+			return;
+		}
+
+		std::atomic<unsigned> next(0U);
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < threads; ++t)
+		{
+			workers.push_back(std::thread([&next, count, &f]()
+			{
+				for (unsigned i = next++; i < count; i = next++)
+				{
+					f(i);
+				}
+			}));
+		}
+		for (unsigned t = 0; t < workers.size(); ++t)
+		{
+			workers[t].join();
+		}
+	}
+
+}
+
+#endif // !CLEARANCE_H
\ No newline at end of file
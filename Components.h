@@ -0,0 +1,385 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <algorithm>
+
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Connected-component labels of the free voxels under one DiagonalMovement;
+		the labels are built brick by brick in parallel with a lock-free union-find,
+		so two voxels are mutually reachable exactly when their labels match
+	*/
+	class Components
+	{
+
+	public:
+
+		Components(const FGrid & g, DiagonalMovement d = DiagonalMovement::Always) : grid(g), dMove(d) {}
+
+		// labels the whole grid, threads == 0 uses every hardware thread
+		void Build(unsigned threads = 0U);
+
+		/*
+			Keeps the labels valid after the cells at Changed have been edited in the grid: freed cells are merged with their neighbours;
+			for a blocked one, a search in the box of BrickSize voxels around it checks that its neighbours still reach each other,
+			and only if they do not, the component it may have split is relabelled, at a cost linear in the size of the component
+		*/
+		void Update(const std::vector<FPosition> & Changed);
+
+		inline bool IsReachable(const FPosition & a, const FPosition & b) const
+		{
+			const size_t la = Label(a);
+			return la != NoLabel && la == Label(b);
+		}
+
+		// NoLabel for blocked voxels and voxels outside the grid
+		inline size_t Label(const FPosition & p) const
+		{
+			if (!parent || !grid(p))
+			{
+				return NoLabel;
+			}
+			return find(index(p));
+		}
+
+		inline DiagonalMovement GetDiagonalMovement() const
+		{
+			return dMove;
+		}
+
+		inline void FreeMemory()
+		{
+			parent.reset();
+			std::vector<bool>().swap(mark);
+		}
+
+		static const size_t NoLabel = size_t(-1);
+
+	private:
+
+		const FGrid & grid;
+		DiagonalMovement dMove;
+		// a blocked voxel may stay an inner node of the forest, the labels are only read for the free ones
+		std::unique_ptr<std::atomic<size_t>[]> parent;
+		// visited voxels of the relabelling flood and of the local search
+		std::vector<bool> mark;
+
+		inline size_t index(const FPosition & p) const
+		{
+			return (size_t(p.z) * grid.y + p.y) * grid.x + p.x;
+		}
+
+		inline FPosition position(size_t i) const
+		{
+			return FPosition(unsigned(i % grid.x), unsigned((i / grid.x) % grid.y), unsigned(i / (size_t(grid.x) * grid.y)));
+		}
+
+		inline size_t find(size_t i) const
+		{
+			size_t p = parent[i].load(std::memory_order_relaxed);
+			while (p != i)
+			{
+				const size_t gp = parent[p].load(std::memory_order_relaxed);
+				// path halving, a lost race only leaves a longer path
+				parent[i].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+				i = gp;
+				p = parent[i].load(std::memory_order_relaxed);
+			}
+			return i;
+		}
+
+		inline void unite(size_t a, size_t b)
+		{
+			while (true)
+			{
+				a = find(a);
+				b = find(b);
+				if (a == b)
+				{
+					return;
+				}
+				// the larger root is linked under the smaller one
+				if (a < b)
+				{
+					std::swap(a, b);
+				}
+				size_t expected = a;
+				if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+				{
+					return;
+				}
+			}
+		}
+
+		void labelBrick(unsigned brick, bool crossBricks);
+		bool reconnects(const FPosition & c, const std::vector<size_t> & targets, std::vector<size_t> & visited);
+		void flood(size_t seed, std::vector<size_t> & visited);
+
+	};
+
+	inline void Components::Build(unsigned threads)
+	{
+		const size_t count = size_t(grid.x) * grid.y * grid.z;
+		parent.reset(new std::atomic<size_t>[count]);
+		for (size_t i = 0; i < count; ++i)
+		{
+			parent[i].store(grid(position(i)) ? i : NoLabel, std::memory_order_relaxed);
+		}
+		mark.assign(count, false);
+
+		if (!threads)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+		}
+		const unsigned bricks = grid.BricksX() * grid.BricksY() * grid.BricksZ();
+		threads = std::min(threads, std::max(bricks, 1U));
+
+		// pass 0 joins the voxels inside every brick, pass 1 across the brick faces
+		for (unsigned pass = 0; pass < 2; ++pass)
+		{
+			std::atomic<unsigned> next(0U);
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t)
+			{
+				workers.push_back(std::thread([this, &next, bricks, pass]()
+				{
+					for (unsigned b = next++; b < bricks; b = next++)
+					{
+						labelBrick(b, pass == 1);
+					}
+				}));
+			}
+			for (unsigned t = 0; t < workers.size(); ++t)
+			{
+				workers[t].join();
+			}
+		}
+
+		// flatten, so every label is one load away
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (parent[i].load(std::memory_order_relaxed) != NoLabel)
+			{
+				parent[i].store(find(i), std::memory_order_relaxed);
+			}
+		}
+	}
+
+	inline void Components::labelBrick(unsigned brick, bool crossBricks)
+	{
+		const unsigned bx = brick % grid.BricksX();
+		const unsigned by = (brick / grid.BricksX()) % grid.BricksY();
+		const unsigned bz = brick / (grid.BricksX() * grid.BricksY());
+		const unsigned x0 = bx << FGrid::BrickShift;
+		const unsigned y0 = by << FGrid::BrickShift;
+		const unsigned z0 = bz << FGrid::BrickShift;
+		const unsigned x1 = std::min(x0 + FGrid::BrickSize, grid.x);
+		const unsigned y1 = std::min(y0 + FGrid::BrickSize, grid.y);
+		const unsigned z1 = std::min(z0 + FGrid::BrickSize, grid.z);
+
+		for (unsigned zz = z0; zz < z1; ++zz)
+		{
+			for (unsigned yy = y0; yy < y1; ++yy)
+			{
+				for (unsigned xx = x0; xx < x1; ++xx)
+				{
+					if (!grid(xx, yy, zz))
+					{
+						continue;
+					}
+					// the second half of the moves is the mirror of the first one
+					for (unsigned d = DirectionCount / 2; d < DirectionCount; ++d)
+					{
+						const unsigned nx = xx + DirX[d];
+						const unsigned ny = yy + DirY[d];
+						const unsigned nz = zz + DirZ[d];
+						const bool inside = nx >= x0 && nx < x1 && ny >= y0 && ny < y1 && nz >= z0 && nz < z1;
+						if (inside == crossBricks || !CanMove(grid, xx, yy, zz, d, dMove))
+						{
+							continue;
+						}
+						unite(index(FPosition(xx, yy, zz)), index(FPosition(nx, ny, nz)));
+					}
+				}
+			}
+		}
+	}
+
+	inline void Components::Update(const std::vector<FPosition> & Changed)
+	{
+		if (!parent)
+		{
+			return;
+		}
+
+		std::vector<size_t> split;
+		for (unsigned i = 0; i < Changed.size(); ++i)
+		{
+			const FPosition & c = Changed[i];
+			if (c.x >= grid.x || c.y >= grid.y || c.z >= grid.z)
+			{
+				continue;
+			}
+			const size_t ci = index(c);
+			if (grid(c))
+			{
+				// freed: the cell and the diagonals it unlocks around it can only join components; the voxels that still lead
+				// through the cell from when it was blocked reach its neighbours, so they join them too
+				parent[ci].store(ci, std::memory_order_relaxed);
+				for (unsigned n = 0; n <= DirectionCount; ++n)
+				{
+					const FPosition p = n < DirectionCount ? FPosition(c.x + DirX[n], c.y + DirY[n], c.z + DirZ[n]) : c;
+					if (!grid(p))
+					{
+						continue;
+					}
+					for (unsigned d = 0; d < DirectionCount; ++d)
+					{
+						if (CanMove(grid, p.x, p.y, p.z, d, dMove))
+						{
+							unite(index(p), index(FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d])));
+						}
+					}
+				}
+			}
+			else if (parent[ci].load(std::memory_order_relaxed) != NoLabel)
+			{
+				// blocked: the moves it ends are all between its neighbours, so the neighbours of its component may now be cut off from each other
+				const size_t root = find(ci);
+				for (unsigned d = 0; d < DirectionCount; ++d)
+				{
+					const FPosition n(c.x + DirX[d], c.y + DirY[d], c.z + DirZ[d]);
+					if (grid(n) && find(index(n)) == root)
+					{
+						split.push_back(index(n));
+					}
+				}
+				std::vector<size_t> visited;
+				const bool whole = reconnects(c, split, visited);
+				for (size_t k = 0; k < visited.size(); ++k)
+				{
+					mark[visited[k]] = false;
+				}
+				visited.clear();
+				if (whole)
+				{
+					// the component stays connected and keeps its labels, the cell stays in the forest
+					split.clear();
+					continue;
+				}
+				// every part the neighbours still reach gets a root of its own
+				for (size_t k = 0; k < split.size(); ++k)
+				{
+					if (!mark[split[k]])
+					{
+						flood(split[k], visited);
+					}
+				}
+				for (size_t k = 0; k < visited.size(); ++k)
+				{
+					mark[visited[k]] = false;
+				}
+				// the flood has relabelled the whole component, nothing leads through the cell any more
+				parent[ci].store(NoLabel, std::memory_order_relaxed);
+				split.clear();
+			}
+		}
+	}
+
+	// whether the targets all reach each other without leaving the box of BrickSize voxels around c; the caller clears the marks of visited
+	inline bool Components::reconnects(const FPosition & c, const std::vector<size_t> & targets, std::vector<size_t> & visited)
+	{
+		if (targets.size() < 2U)
+		{
+			return true;
+		}
+		const unsigned r = FGrid::BrickSize;
+		const FPosition lo(c.x > r ? c.x - r : 0U, c.y > r ? c.y - r : 0U, c.z > r ? c.z - r : 0U);
+		const FPosition hi(c.x + r, c.y + r, c.z + r);
+		for (size_t k = 0; k < targets.size(); ++k)
+		{
+			mark[targets[k]] = true;
+			visited.push_back(targets[k]);
+		}
+		// the marks of the targets stand for not found yet until the search gets to them
+		std::vector<bool> found(targets.size(), false);
+		size_t left = targets.size() - 1U;
+		found[0] = true;
+		std::deque<size_t> queue(1, targets[0]);
+		while (!queue.empty() && left)
+		{
+			const FPosition p = position(queue.front());
+			queue.pop_front();
+			for (unsigned d = 0; d < DirectionCount && left; ++d)
+			{
+				const FPosition n(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+				if (n.x < lo.x || n.y < lo.y || n.z < lo.z || n.x > hi.x || n.y > hi.y || n.z > hi.z || !CanMove(grid, p.x, p.y, p.z, d, dMove))
+				{
+					continue;
+				}
+				const size_t ni = index(n);
+				if (mark[ni])
+				{
+					const std::vector<size_t>::const_iterator t = std::find(targets.begin(), targets.end(), ni);
+					if (t == targets.end() || found[t - targets.begin()])
+					{
+						continue;
+					}
+					found[t - targets.begin()] = true;
+					--left;
+				}
+				else
+				{
+					mark[ni] = true;
+					visited.push_back(ni);
+				}
+				queue.push_back(ni);
+			}
+		}
+		return !left;
+	}
+
+	// relabels everything reachable from seed with seed as the new root, the caller clears the marks of visited
+	inline void Components::flood(size_t seed, std::vector<size_t> & visited)
+	{
+		std::vector<size_t> stack(1, seed);
+		mark[seed] = true;
+		while (!stack.empty())
+		{
+			const size_t i = stack.back();
+			stack.pop_back();
+			visited.push_back(i);
+			parent[i].store(seed, std::memory_order_relaxed);
+
+			const FPosition p = position(i);
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				if (!CanMove(grid, p.x, p.y, p.z, d, dMove))
+				{
+					continue;
+				}
+				const size_t n = index(FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]));
+				if (!mark[n])
+				{
+					mark[n] = true;
+					stack.push_back(n);
+				}
+			}
+		}
+	}
+
+}
+
+#endif // !COMPONENTS_H
\ No newline at end of file
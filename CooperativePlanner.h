@@ -0,0 +1,364 @@
+#ifndef COOPERATIVE_PLANNER_H
+#define COOPERATIVE_PLANNER_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <queue>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+#include "ReservationTable.h"
+
+namespace JPS {
+
+	/*
+		Reverse Resumable A*: the exact distances to a goal, searched backwards from it towards an origin
+		and resumed whenever a voxel not closed yet is asked for; with the consistent DirectionDistance heuristic
+		every closed voxel has its exact distance, whatever the origin
+	*/
+	class TrueDistance
+	{
+
+	public:
+
+		TrueDistance(const FGrid & g, DiagonalMovement d, const FPosition & Goal, const FPosition & Origin);
+
+		// the cost of the cheapest path from p to the goal in DirectionCost units, Infinity if there is none
+		unsigned Get(const FPosition & p);
+
+		inline const FPosition & GetGoal() const
+		{
+			return goal;
+		}
+
+		static const unsigned Infinity = unsigned(-1);
+
+	private:
+
+		typedef std::pair<unsigned, FPosition> QueueItem;
+
+		struct FState
+		{
+			unsigned g = Infinity;
+			bool closed = false;
+		};
+
+		const FGrid & grid;
+		DiagonalMovement dMove;
+		FPosition goal, origin;
+		std::map<FPosition, FState> states;
+		std::set<QueueItem> open;
+
+	};
+
+	/*
+		Windowed Hierarchical Cooperative A* (WHCA*): the agents plan one after another, each one a space-time A*
+		over the voxels and the time steps of the next Window steps around the reservations of the ones before it,
+		with the true distance to its goal as the heuristic; the search ends at the window, so the work per agent
+		depends on the window and not on the number of agents. The jumps skip time steps, so the space-time search
+		takes unit moves and waits under the corner rules of the searcher instead
+	*/
+	class CooperativePlanner
+	{
+
+	public:
+
+		CooperativePlanner(const FGrid & g, unsigned Window = 16U, DiagonalMovement d = DiagonalMovement::Always) :
+			grid(g), window(std::max(Window, 1U)), dMove(d), reservations(g) {}
+
+		/*
+			Plans the next Window steps of Agent from Start at the time step Now towards Goal and reserves them,
+			after dropping the reservations the agent held; the agents planned before keep theirs, so the order of the calls is the priority.
+			Returns: 1) empty vector - the start is blocked or held by an agent planned before
+					 2) the voxel of every time step from Now to Now + Window, the first one the start;
+						an agent with no way forward waits where it is, at its goal only if no one needs it until the window ends
+					 3) fewer voxels - every way is cut by the agents planned before it within the window; the steps it can
+						take are reserved and returned, the agent is best planned again at a higher priority
+		*/
+		std::vector<FPosition> PlanWindow(unsigned Agent, FPosition Start, FPosition Goal, unsigned Now);
+
+		// plans the agents 0 to n - 1 in this order; the order is best rotated between the windows, so no agent always yields
+		std::vector<std::vector<FPosition>> PlanFleet(const std::vector<FPosition> & Starts, const std::vector<FPosition> & Goals, unsigned Now);
+
+		// drops the reservations and the distances of an agent that has left
+		inline void ForgetAgent(unsigned Agent)
+		{
+			reservations.Release(Agent);
+			distances.erase(Agent);
+		}
+
+		inline ReservationTable & GetReservations()
+		{
+			return reservations;
+		}
+
+		inline unsigned GetWindow() const
+		{
+			return window;
+		}
+
+		// space-time states expanded by the last PlanWindow
+		inline unsigned GetExpansions() const
+		{
+			return expansions;
+		}
+
+		// the cost of one time step spent waiting, away from the goal
+		static const unsigned WaitCost = 10U;
+
+	private:
+
+		struct FNode
+		{
+			FPosition pos;
+			unsigned step;
+			unsigned g;
+			unsigned parent;
+			bool closed;
+		};
+
+		// (f, deeper first, node)
+		typedef std::pair<std::pair<unsigned, unsigned>, unsigned> QueueItem;
+
+		const FGrid & grid;
+		unsigned window;
+		DiagonalMovement dMove;
+		ReservationTable reservations;
+		std::map<unsigned, std::unique_ptr<TrueDistance>> distances;
+		unsigned expansions = 0U;
+
+		TrueDistance & distance(unsigned Agent, const FPosition & Start, const FPosition & Goal);
+		bool goalHeld(unsigned Agent, const FPosition & Goal, unsigned from, unsigned to) const;
+
+	};
+
+	inline TrueDistance::TrueDistance(const FGrid & g, DiagonalMovement d, const FPosition & Goal, const FPosition & Origin) :
+		grid(g), dMove(d), goal(Goal), origin(Origin)
+	{
+		if (grid(goal))
+		{
+			states[goal].g = 0U;
+			open.insert(QueueItem(DirectionDistance(goal, origin), goal));
+		}
+	}
+
+	inline unsigned TrueDistance::Get(const FPosition & p)
+	{
+		std::map<FPosition, FState>::const_iterator s = states.find(p);
+		if (s != states.end() && s->second.closed)
+		{
+			return s->second.g;
+		}
+		if (!grid(p))
+		{
+			return Infinity;
+		}
+
+		while (!open.empty())
+		{
+			const FPosition cur = open.begin()->second;
+			open.erase(open.begin());
+			FState & cs = states[cur];
+			cs.closed = true;
+
+			// the moves are symmetric, so the backward search takes the same ones
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				if (!CanMove(grid, cur.x, cur.y, cur.z, d, dMove))
+				{
+					continue;
+				}
+				const FPosition n(cur.x + DirX[d], cur.y + DirY[d], cur.z + DirZ[d]);
+				FState & ns = states[n];
+				const unsigned g = cs.g + DirectionCost(d);
+				if (ns.closed || g >= ns.g)
+				{
+					continue;
+				}
+				if (ns.g != Infinity)
+				{
+					open.erase(QueueItem(ns.g + DirectionDistance(n, origin), n));
+				}
+				ns.g = g;
+				open.insert(QueueItem(g + DirectionDistance(n, origin), n));
+			}
+
+			if (cur == p)
+			{
+				return cs.g;
+			}
+		}
+		return Infinity;
+	}
+
+	inline TrueDistance & CooperativePlanner::distance(unsigned Agent, const FPosition & Start, const FPosition & Goal)
+	{
+		std::map<unsigned, std::unique_ptr<TrueDistance>>::iterator it = distances.find(Agent);
+		if (it == distances.end() || it->second->GetGoal() != Goal)
+		{
+			// a new goal starts a new backward search, an old one keeps every distance found so far
+			std::unique_ptr<TrueDistance> d(new TrueDistance(grid, dMove, Goal, Start));
+			it = distances.insert(std::make_pair(Agent, std::unique_ptr<TrueDistance>())).first;
+			it->second = std::move(d);
+		}
+		return *it->second;
+	}
+
+	// whether another agent holds the goal at any time step in [from, to]
+	inline bool CooperativePlanner::goalHeld(unsigned Agent, const FPosition & Goal, unsigned from, unsigned to) const
+	{
+		for (unsigned t = from; t <= to; ++t)
+		{
+			if (!reservations.IsFree(Goal, t, Agent))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline std::vector<FPosition> CooperativePlanner::PlanWindow(unsigned Agent, FPosition Start, FPosition Goal, unsigned Now)
+	{
+		expansions = 0U;
+		reservations.Release(Agent);
+		std::vector<FPosition> plan;
+		if (!grid(Start) || !reservations.IsFree(Start, Now, Agent))
+		{
+			// 1) the start is blocked, or held by an agent planned before
+			return plan;
+		}
+
+		TrueDistance & h = distance(Agent, Start, Goal);
+		std::vector<FNode> nodes;
+		// (voxel, step) -> node; the steps are bounded by the window, so the pair fits 64 bits on any grid that fits in memory
+		std::unordered_map<uint64_t, unsigned> index;
+		std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+		const uint64_t steps = window + 1U;
+		const auto keyOf = [this, steps](const FPosition & p, unsigned step) -> uint64_t
+		{
+			return ((uint64_t(p.z) * grid.y + p.y) * grid.x + p.x) * steps + step;
+		};
+
+		const unsigned h0 = h.Get(Start);
+		FNode first = { Start, 0U, 0U, unsigned(-1), false };
+		nodes.push_back(first);
+		index[keyOf(Start, 0U)] = 0U;
+		open.push(QueueItem(std::make_pair(h0 == TrueDistance::Infinity ? 0U : h0, window), 0U));
+
+		// the state the plan ends in: the first one at the window or at a free goal, else the deepest one reached
+		unsigned last = 0U;
+		bool complete = false;
+		while (!open.empty())
+		{
+			const unsigned i = open.top().second;
+			open.pop();
+			if (nodes[i].closed)
+			{
+				continue;
+			}
+			nodes[i].closed = true;
+			++expansions;
+			if (nodes[i].step > nodes[last].step)
+			{
+				last = i;
+			}
+
+			const FNode cur = nodes[i];
+			// the window ends the search, as does a goal no one needs until then; a goal needed later is left
+			// to the waits and the moves around it
+			if (cur.step == window || (cur.pos == Goal && !goalHeld(Agent, Goal, Now + cur.step, Now + window)))
+			{
+				last = i;
+				complete = true;
+				break;
+			}
+
+			for (unsigned d = 0; d <= DirectionCount; ++d)
+			{
+				// d == DirectionCount waits
+				const bool wait = d == DirectionCount;
+				if (!wait && !CanMove(grid, cur.pos.x, cur.pos.y, cur.pos.z, d, dMove))
+				{
+					continue;
+				}
+				const FPosition n = wait ? cur.pos : FPosition(cur.pos.x + DirX[d], cur.pos.y + DirY[d], cur.pos.z + DirZ[d]);
+				if (!reservations.CanTraverse(cur.pos, n, Now + cur.step, Agent))
+				{
+					continue;
+				}
+				const unsigned hn = h.Get(n);
+				if (hn == TrueDistance::Infinity && h0 != TrueDistance::Infinity)
+				{
+					continue;
+				}
+
+				// waiting at the goal is free, the agent is done there
+				const unsigned g = cur.g + (wait ? (cur.pos == Goal ? 0U : WaitCost) : DirectionCost(d));
+				const uint64_t k = keyOf(n, cur.step + 1U);
+				const std::unordered_map<uint64_t, unsigned>::iterator it = index.find(k);
+				unsigned ni;
+				if (it == index.end())
+				{
+					ni = unsigned(nodes.size());
+					FNode node = { n, cur.step + 1U, g, i, false };
+					nodes.push_back(node);
+					index.insert(std::make_pair(k, ni));
+				}
+				else
+				{
+					ni = it->second;
+					if (nodes[ni].closed || g >= nodes[ni].g)
+					{
+						continue;
+					}
+					nodes[ni].g = g;
+					nodes[ni].parent = i;
+				}
+				open.push(QueueItem(std::make_pair(g + (h0 == TrueDistance::Infinity ? 0U : hn), window - (cur.step + 1U)), ni));
+			}
+		}
+
+		// 2) the states back to the start, then the goal held until the window ends
+		for (unsigned i = last; i != unsigned(-1); i = nodes[i].parent)
+		{
+			plan.push_back(nodes[i].pos);
+		}
+		std::reverse(plan.begin(), plan.end());
+		while (complete && plan.size() < window + 1U)
+		{
+			plan.push_back(plan.back());
+		}
+		for (unsigned t = 0; t < plan.size(); ++t)
+		{
+			// the search only takes free states, so this holds unless the table was edited in between
+			if (!reservations.Reserve(plan[t], Now + t, Agent))
+			{
+				// 3) the plan ends before the conflict
+				plan.resize(t);
+				break;
+			}
+		}
+		return plan;
+	}
+
+	inline std::vector<std::vector<FPosition>> CooperativePlanner::PlanFleet(const std::vector<FPosition> & Starts, const std::vector<FPosition> & Goals, unsigned Now)
+	{
+		std::vector<std::vector<FPosition>> plans(Starts.size());
+		for (unsigned i = 0; i < Starts.size() && i < Goals.size(); ++i)
+		{
+			plans[i] = PlanWindow(i, Starts[i], Goals[i], Now);
+		}
+		return plans;
+	}
+
+}
+
+#endif // !COOPERATIVE_PLANNER_H
\ No newline at end of file
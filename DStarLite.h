@@ -0,0 +1,345 @@
+#ifndef D_STAR_LITE_H
+#define D_STAR_LITE_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Incremental planner (D* Lite): the search runs backwards from the goal and its tree is kept between calls,
+		so after a move of the start or an edit of a few cells only the voxels whose cost to the goal changed
+		are expanded again; every voxel is a vertex with its 26 moves, JPS pruning does not survive edits
+	*/
+	class DStarLite
+	{
+
+	public:
+
+		DStarLite(const FGrid & g, DiagonalMovement d = DiagonalMovement::Always) : grid(g), dMove(d) {}
+
+		/*
+			Plans from Start to Goal, reusing the previous search while the goal stays the same;
+			Returns: 1) empty vector - the path does not exist
+					 2) vector with the only element - the start and the finish match
+					 3) vector with the start, the voxels where the direction changes and the finish
+		*/
+		std::vector<FPosition> FindPath(FPosition Start, FPosition Goal);
+
+		// the cells at Changed have been edited in the grid, they are repaired on the next FindPath
+		inline void Update(const std::vector<FPosition> & Changed)
+		{
+			pending.insert(pending.end(), Changed.begin(), Changed.end());
+		}
+
+		// cost of the last path in DirectionCost units, unsigned(-1) if there is none
+		inline unsigned GetCost() const
+		{
+			return getG(start);
+		}
+
+		// voxels expanded by the last FindPath
+		inline unsigned GetExpansions() const
+		{
+			return expansions;
+		}
+
+		inline void FreeMemory()
+		{
+			std::map<FPosition, FState>().swap(states);
+			std::set<QueueItem>().swap(open);
+			std::vector<FPosition>().swap(pending);
+			goal = FPosition();
+		}
+
+		static const unsigned Infinity = unsigned(-1);
+
+	private:
+
+		typedef std::pair<unsigned, unsigned> Key;
+		typedef std::pair<Key, FPosition> QueueItem;
+
+		struct FState
+		{
+			unsigned g = Infinity;
+			unsigned rhs = Infinity;
+			// the key the voxel is queued with, valid while queued
+			Key key;
+			bool queued = false;
+		};
+
+		const FGrid & grid;
+		DiagonalMovement dMove;
+		FPosition start, goal, last;
+		// accumulated heuristic drift of the moving start
+		unsigned km = 0U;
+		unsigned expansions = 0U;
+		std::map<FPosition, FState> states;
+		std::set<QueueItem> open;
+		std::vector<FPosition> pending;
+
+		static inline unsigned add(unsigned a, unsigned b)
+		{
+			return a == Infinity || b == Infinity ? Infinity : a + b;
+		}
+
+		inline unsigned getG(const FPosition & p) const
+		{
+			std::map<FPosition, FState>::const_iterator it = states.find(p);
+			return it == states.end() ? Infinity : it->second.g;
+		}
+
+		inline Key calculateKey(const FPosition & p, const FState & s) const
+		{
+			const unsigned m = std::min(s.g, s.rhs);
+			return Key(add(add(m, DirectionDistance(start, p)), km), m);
+		}
+
+		void reset();
+		void repair(const FPosition & cell);
+		void updateVertex(const FPosition & p, FState & s);
+		unsigned bestRhs(const FPosition & p) const;
+		void computeShortestPath();
+		std::vector<FPosition> extractPath() const;
+
+	};
+
+	inline std::vector<FPosition> DStarLite::FindPath(FPosition Start, FPosition Goal)
+	{
+		expansions = 0U;
+		std::vector<FPosition> path;
+		if (!grid(Start) || !grid(Goal))
+		{
+			// 1) the path does not exist
+			return path;
+		}
+		if (Start == Goal)
+		{
+			// 2) the start and the finish match
+			path.push_back(Start);
+			return path;
+		}
+
+		start = Start;
+		if (Goal != goal)
+		{
+			goal = Goal;
+			reset();
+		}
+		else if (start != last)
+		{
+			km += DirectionDistance(last, start);
+		}
+		last = start;
+
+		for (unsigned i = 0; i < pending.size(); ++i)
+		{
+			repair(pending[i]);
+		}
+		pending.clear();
+
+		computeShortestPath();
+		// 3) the path
+		return extractPath();
+	}
+
+	inline void DStarLite::reset()
+	{
+		states.clear();
+		open.clear();
+		pending.clear();
+		km = 0U;
+
+		FState & s = states[goal];
+		s.rhs = 0U;
+		updateVertex(goal, s);
+	}
+
+	// every move whose cost an edit can change starts within one voxel of the edited cell
+	inline void DStarLite::repair(const FPosition & cell)
+	{
+		for (int dz = -1; dz <= 1; ++dz)
+		{
+			for (int dy = -1; dy <= 1; ++dy)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					const FPosition p(cell.x + dx, cell.y + dy, cell.z + dz);
+					std::map<FPosition, FState>::iterator it = states.find(p);
+					if (p == goal || (it == states.end() && !grid(p)))
+					{
+						continue;
+					}
+					// a freed voxel may border the tree without being in it yet
+					FState & s = it == states.end() ? states[p] : it->second;
+					s.rhs = bestRhs(p);
+					updateVertex(p, s);
+				}
+			}
+		}
+	}
+
+	inline void DStarLite::updateVertex(const FPosition & p, FState & s)
+	{
+		if (s.queued)
+		{
+			open.erase(QueueItem(s.key, p));
+			s.queued = false;
+		}
+		if (s.g != s.rhs)
+		{
+			s.key = calculateKey(p, s);
+			s.queued = true;
+			open.insert(QueueItem(s.key, p));
+		}
+	}
+
+	// one-step lookahead over the moves that are allowed now, blocked voxels get infinity
+	inline unsigned DStarLite::bestRhs(const FPosition & p) const
+	{
+		unsigned best = Infinity;
+		if (!grid(p))
+		{
+			return best;
+		}
+		for (unsigned d = 0; d < DirectionCount; ++d)
+		{
+			if (CanMove(grid, p.x, p.y, p.z, d, dMove))
+			{
+				best = std::min(best, add(DirectionCost(d), getG(FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]))));
+			}
+		}
+		return best;
+	}
+
+	inline void DStarLite::computeShortestPath()
+	{
+		FState * st = &states[start];
+		while (!open.empty() && (open.begin()->first < calculateKey(start, *st) || st->rhs != st->g))
+		{
+			const QueueItem top = *open.begin();
+			const FPosition u = top.second;
+			FState & su = states[u];
+			const Key fresh = calculateKey(u, su);
+			if (top.first < fresh)
+			{
+				// the key is stale since the start has moved
+				updateVertex(u, su);
+				continue;
+			}
+
+			++expansions;
+			open.erase(open.begin());
+			su.queued = false;
+			// the moves are symmetric, so the successors of u are its predecessors too
+			if (su.g > su.rhs)
+			{
+				su.g = su.rhs;
+				for (unsigned d = 0; d < DirectionCount; ++d)
+				{
+					if (!CanMove(grid, u.x, u.y, u.z, d, dMove))
+					{
+						continue;
+					}
+					const FPosition n(u.x + DirX[d], u.y + DirY[d], u.z + DirZ[d]);
+					if (n == goal)
+					{
+						continue;
+					}
+					FState & sn = states[n];
+					const unsigned through = add(DirectionCost(d), su.g);
+					if (through < sn.rhs)
+					{
+						sn.rhs = through;
+						updateVertex(n, sn);
+					}
+				}
+			}
+			else
+			{
+				const unsigned old = su.g;
+				su.g = Infinity;
+				for (unsigned d = 0; d <= DirectionCount; ++d)
+				{
+					if (d < DirectionCount && !CanMove(grid, u.x, u.y, u.z, d, dMove))
+					{
+						continue;
+					}
+					const FPosition n = d < DirectionCount ? FPosition(u.x + DirX[d], u.y + DirY[d], u.z + DirZ[d]) : u;
+					if (n == goal)
+					{
+						continue;
+					}
+					FState & sn = states[n];
+					// only the voxels that relied on u look for another way
+					if (n == u || sn.rhs == add(DirectionCost(d), old))
+					{
+						sn.rhs = bestRhs(n);
+					}
+					updateVertex(n, sn);
+				}
+			}
+		}
+	}
+
+	inline std::vector<FPosition> DStarLite::extractPath() const
+	{
+		std::vector<FPosition> path;
+		if (getG(start) == Infinity)
+		{
+			// 1) the path does not exist
+			return path;
+		}
+
+		path.push_back(start);
+		FPosition cur = start;
+		unsigned prev = NoDirection;
+		// g strictly falls along the path, the bound only guards against a tree left inconsistent by an edit
+		for (size_t steps = 0; cur != goal && steps <= states.size(); ++steps)
+		{
+			unsigned best = Infinity;
+			unsigned dir = NoDirection;
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				if (!CanMove(grid, cur.x, cur.y, cur.z, d, dMove))
+				{
+					continue;
+				}
+				const unsigned cost = add(DirectionCost(d), getG(FPosition(cur.x + DirX[d], cur.y + DirY[d], cur.z + DirZ[d])));
+				if (cost < best)
+				{
+					best = cost;
+					dir = d;
+				}
+			}
+			if (dir == NoDirection)
+			{
+				return std::vector<FPosition>();
+			}
+
+			// only the voxels where the direction changes are kept
+			if (dir != prev && prev != NoDirection)
+			{
+				path.push_back(cur);
+			}
+			prev = dir;
+			cur = FPosition(cur.x + DirX[dir], cur.y + DirY[dir], cur.z + DirZ[dir]);
+		}
+		if (cur != goal)
+		{
+			return std::vector<FPosition>();
+		}
+		path.push_back(goal);
+		return path;
+	}
+
+}
+
+#endif // !D_STAR_LITE_H
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef DIRECTIONS_H
+#define DIRECTIONS_H
+
+#include <cstdint>
+#include <algorithm>
+
+#include "EDiagonalMovement.h"
+#include "Grid.h"
+
+namespace JPS {
+
+	/*
+		The 26 unit moves of the voxel grid, ordered so that the opposite of the move d is 25 - d;
+		straight moves cost 10, 2D diagonals 14 and 3D diagonals 17 (scaled Euclidean lengths)
+	*/
+	static const unsigned DirectionCount = 26U;
+	static const uint8_t NoDirection = uint8_t(31);
+
+	static const int DirX[DirectionCount] = { -1, 0, 1, -1, 0, 1, -1, 0, 1, -1, 0, 1, -1, 1, -1, 0, 1, -1, 0, 1, -1, 0, 1, -1, 0, 1 };
+	static const int DirY[DirectionCount] = { -1, -1, -1, 0, 0, 0, 1, 1, 1, -1, -1, -1, 0, 0, 1, 1, 1, -1, -1, -1, 0, 0, 0, 1, 1, 1 };
+	static const int DirZ[DirectionCount] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+	inline unsigned OppositeDirection(unsigned d)
+	{
+		return DirectionCount - 1U - d;
+	}
+
+	// index of the unit move (dx, dy, dz), each of them -1, 0 or 1 and not all zero
+	inline unsigned DirectionIndex(int dx, int dy, int dz)
+	{
+		const unsigned raw = unsigned((dz + 1) * 9 + (dy + 1) * 3 + (dx + 1));
+		return raw > 13U ? raw - 1U : raw;
+	}
+
+	inline unsigned DirectionAxes(unsigned d)
+	{
+		return unsigned(DirX[d] != 0) + unsigned(DirY[d] != 0) + unsigned(DirZ[d] != 0);
+	}
+
+	inline unsigned DirectionCost(unsigned d)
+	{
+		static const unsigned costs[4] = { 0U, 10U, 14U, 17U };
+		return costs[DirectionAxes(d)];
+	}
+
+	// cost of the cheapest moves from a to b over an empty grid, a consistent heuristic for every DiagonalMovement
+	inline unsigned DirectionDistance(const FPosition & a, const FPosition & b)
+	{
+		unsigned d[3] =
+		{
+			a.x > b.x ? a.x - b.x : b.x - a.x,
+			a.y > b.y ? a.y - b.y : b.y - a.y,
+			a.z > b.z ? a.z - b.z : b.z - a.z
+		};
+		std::sort(d, d + 3);
+		return 17U * d[0] + 14U * (d[1] - d[0]) + 10U * (d[2] - d[1]);
+	}
+
+	/*
+		Whether one step from (x, y, z) along d is allowed; the corner rules of the diagonal moves
+		are the same as the ones FindNeighbours applies to a node without a parent;
+		the move is symmetric, so it also tells whether the target can step back
+	*/
+	template <class TGrid>
+	inline bool CanMove(const TGrid & g, unsigned x, unsigned y, unsigned z, unsigned d, DiagonalMovement dMove)
+	{
+		const int dx = DirX[d];
+		const int dy = DirY[d];
+		const int dz = DirZ[d];
+		if (!g(x + dx, y + dy, z + dz))
+		{
+			return false;
+		}
+
+		const unsigned axes = DirectionAxes(d);
+		if (axes == 1U || dMove == DiagonalMovement::Always)
+		{
+			return true;
+		}
+		if (dMove == DiagonalMovement::Never)
+		{
+			return false;
+		}
+
+		bool any = false;
+		bool all = true;
+		if (axes == 2U)
+		{
+			const bool a = dx ? g(x + dx, y, z) : g(x, y + dy, z);
+			const bool b = dz ? g(x, y, z + dz) : g(x, y + dy, z);
+			any = a || b;
+			all = a && b;
+		}
+		else
+		{
+			const bool cells[6] =
+			{
+				g(x + dx, y, z), g(x, y + dy, z), g(x, y, z + dz),
+				g(x + dx, y + dy, z), g(x + dx, y, z + dz), g(x, y + dy, z + dz)
+			};
+			for (unsigned i = 0; i < 6; ++i)
+			{
+				any = any || cells[i];
+				all = all && cells[i];
+			}
+		}
+		return dMove == DiagonalMovement::AtLeastOnePassable ? any : all;
+	}
+
+}
+
+#endif // !DIRECTIONS_H
\ No newline at end of file
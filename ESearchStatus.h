@@ -0,0 +1,21 @@
+#ifndef SEARCH_STATUS_H
+#define SEARCH_STATUS_H
+
+#include <cstdint>
+
+namespace JPS {
+
+	enum class SearchStatus : uint8_t
+	{
+		Found,
+		NoPath,
+		Running,
+		ExpansionLimit,
+		StepLimit,
+		TimeLimit,
+		Cancelled
+	};
+
+}
+
+#endif // !SEARCH_STATUS_H
\ No newline at end of file
@@ -0,0 +1,435 @@
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Reverse Dijkstra sweep from one goal over the grid (or a box of it); every voxel keeps the direction
+		of its next step towards the goal packed in 5 bits, so agents follow the field without any search;
+		JPS pruning does not apply here since every voxel of the region needs its own direction.
+		The distances of the sweep are only kept while a build or an update runs, so the field costs 5 bits per voxel
+	*/
+	class FlowField
+	{
+
+	public:
+
+		FlowField(const FGrid & g, DiagonalMovement d = DiagonalMovement::Always) : grid(g), dMove(d) {}
+
+		// the whole grid
+		void Build(FPosition Goal)
+		{
+			Build(Goal, FPosition(0, 0, 0), FPosition(grid.x - 1, grid.y - 1, grid.z - 1));
+		}
+
+		// only the box [Min, Max] (inclusive), the paths do not leave it
+		void Build(FPosition Goal, FPosition Min, FPosition Max);
+
+		/*
+			Repairs the field after the cells at Changed have been edited in the grid:
+			only the voxels whose route went through or next to a changed cell are recomputed
+		*/
+		void Update(const std::vector<FPosition> & Changed);
+
+		inline bool Contains(const FPosition & p) const
+		{
+			return p.x >= min.x && p.y >= min.y && p.z >= min.z && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+		}
+
+		// direction index (see Directions.h) of the next step from p, NoDirection at the goal or if the goal is unreachable
+		inline uint8_t Direction(const FPosition & p) const
+		{
+			return Contains(p) ? getDir(index(p)) : NoDirection;
+		}
+
+		// cost to the goal in DirectionCost units, unsigned(-1) if unreachable; follows the field, so it takes a step per voxel of the path
+		inline unsigned Distance(const FPosition & p) const
+		{
+			return Contains(p) ? walk(index(p)) : unsigned(-1);
+		}
+
+		inline FPosition Next(const FPosition & p) const
+		{
+			const uint8_t d = Direction(p);
+			if (d == NoDirection)
+			{
+				return FPosition();
+			}
+			return FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+		}
+
+		/*
+			Follows the field from Start;
+			Returns: 1) empty vector - the goal is unreachable from Start
+					 2) vector with the only element - Start is the goal
+					 3) vector with the start, the voxels where the direction changes and the goal
+		*/
+		std::vector<FPosition> FollowPath(FPosition Start) const;
+
+		inline FPosition GetGoal() const
+		{
+			return goal;
+		}
+
+		inline void FreeMemory()
+		{
+			std::vector<uint64_t>().swap(dirs);
+			goalOpen = false;
+		}
+
+	private:
+
+		typedef std::pair<unsigned, size_t> QueueItem;
+		typedef std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> Queue;
+
+		// the distances of one build, over the whole box, or of one update, of the voxels it meets
+		struct FDistances
+		{
+			std::vector<unsigned> dense;
+			std::unordered_map<size_t, unsigned> sparse;
+		};
+
+		// 12 directions of 5 bits in every word
+		static const unsigned DirsPerWord = 12U;
+
+		const FGrid & grid;
+		DiagonalMovement dMove;
+		FPosition goal, min, max;
+		unsigned sx = 0U, sy = 0U, sz = 0U;
+		std::vector<uint64_t> dirs;
+		// whether the goal was free when the field was built
+		bool goalOpen = false;
+
+		inline size_t index(const FPosition & p) const
+		{
+			return (size_t(p.z - min.z) * sy + (p.y - min.y)) * sx + (p.x - min.x);
+		}
+
+		inline FPosition position(size_t i) const
+		{
+			return FPosition(unsigned(min.x + i % sx), unsigned(min.y + (i / sx) % sy), unsigned(min.z + i / (size_t(sx) * sy)));
+		}
+
+		inline uint8_t getDir(size_t i) const
+		{
+			return uint8_t((dirs[i / DirsPerWord] >> (5U * (i % DirsPerWord))) & 31U);
+		}
+
+		inline void setDir(size_t i, uint8_t d)
+		{
+			const unsigned shift = unsigned(5U * (i % DirsPerWord));
+			uint64_t & w = dirs[i / DirsPerWord];
+			w = (w & ~(uint64_t(31U) << shift)) | (uint64_t(d) << shift);
+		}
+
+		inline bool passable(const FPosition & p) const
+		{
+			return Contains(p) && grid(p);
+		}
+
+		// the voxel the field leads to from i, i itself at the goal or where the field ends
+		inline size_t step(size_t i) const
+		{
+			const uint8_t d = getDir(i);
+			if (d == NoDirection)
+			{
+				return i;
+			}
+			const FPosition p = position(i);
+			return index(FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]));
+		}
+
+		// the cost of following the field from i to the goal
+		unsigned walk(size_t i) const;
+
+		// the distance of i during an update, the cost of following the field for a voxel the update has not met yet
+		unsigned distance(FDistances & D, size_t i) const;
+
+		inline void settle(FDistances & D, size_t i, unsigned d) const
+		{
+			if (D.dense.empty())
+			{
+				// a route through i passes one of its neighbours, which keeps the distance it had, so the sweep still relaxes it
+				const FPosition p = position(i);
+				for (unsigned k = 0; k < DirectionCount; ++k)
+				{
+					const FPosition n(p.x + DirX[k], p.y + DirY[k], p.z + DirZ[k]);
+					if (Contains(n))
+					{
+						distance(D, index(n));
+					}
+				}
+				D.sparse[i] = d;
+			}
+			else
+			{
+				D.dense[i] = d;
+			}
+		}
+
+		void sweep(Queue & open, FDistances & D);
+
+	};
+
+	inline void FlowField::Build(FPosition Goal, FPosition Min, FPosition Max)
+	{
+		goal = Goal;
+		min = FPosition(std::min(Min.x, Max.x), std::min(Min.y, Max.y), std::min(Min.z, Max.z));
+		max = FPosition(std::min(std::max(Min.x, Max.x), grid.x - 1), std::min(std::max(Min.y, Max.y), grid.y - 1), std::min(std::max(Min.z, Max.z), grid.z - 1));
+		sx = max.x - min.x + 1;
+		sy = max.y - min.y + 1;
+		sz = max.z - min.z + 1;
+
+		const size_t count = size_t(sx) * sy * sz;
+		dirs.assign((count + DirsPerWord - 1) / DirsPerWord, ~uint64_t(0));
+		goalOpen = passable(Goal);
+		if (!goalOpen)
+		{
+			// nothing leads to the goal
+			return;
+		}
+
+		// the distances of the sweep, 32 bits per voxel, only live until it ends
+		FDistances D;
+		D.dense.assign(count, unsigned(-1));
+		Queue open;
+		D.dense[index(Goal)] = 0U;
+		open.push(QueueItem(0U, index(Goal)));
+		sweep(open, D);
+	}
+
+	inline void FlowField::Update(const std::vector<FPosition> & Changed)
+	{
+		if (dirs.empty())
+		{
+			return;
+		}
+		if (!passable(goal) || !goalOpen)
+		{
+			// the goal itself has changed
+			Build(goal, min, max);
+			return;
+		}
+
+		// roots of the invalidated subtrees: the changed cells and the neighbours whose step became illegal
+		std::vector<size_t> stack;
+		for (unsigned i = 0; i < Changed.size(); ++i)
+		{
+			const FPosition & c = Changed[i];
+			if (!Contains(c))
+			{
+				continue;
+			}
+			stack.push_back(index(c));
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				const FPosition n(c.x + DirX[d], c.y + DirY[d], c.z + DirZ[d]);
+				if (!Contains(n))
+				{
+					continue;
+				}
+				const uint8_t nd = getDir(index(n));
+				if (nd != NoDirection && !CanMove(grid, n.x, n.y, n.z, nd, dMove))
+				{
+					stack.push_back(index(n));
+				}
+			}
+		}
+
+		// invalidate every voxel whose route passes through a root; without a direction a voxel is unreachable, but the goal
+		std::vector<size_t> invalid;
+		while (!stack.empty())
+		{
+			const size_t i = stack.back();
+			stack.pop_back();
+			if (getDir(i) == NoDirection)
+			{
+				continue;
+			}
+			setDir(i, NoDirection);
+			invalid.push_back(i);
+
+			const FPosition p = position(i);
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				const FPosition n(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+				if (Contains(n) && getDir(index(n)) == OppositeDirection(d))
+				{
+					stack.push_back(index(n));
+				}
+			}
+		}
+
+		// reseed from the valid voxels around the invalidated ones and the changed cells
+		FDistances D;
+		Queue open;
+		for (size_t k = 0; k < invalid.size() + Changed.size(); ++k)
+		{
+			const FPosition p = k < invalid.size() ? position(invalid[k]) : Changed[k - invalid.size()];
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				const FPosition n(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+				if (!passable(n))
+				{
+					continue;
+				}
+				const unsigned nd = distance(D, index(n));
+				if (nd != unsigned(-1))
+				{
+					open.push(QueueItem(nd, index(n)));
+				}
+			}
+		}
+		sweep(open, D);
+	}
+
+	inline unsigned FlowField::walk(size_t i) const
+	{
+		if (!goalOpen)
+		{
+			return unsigned(-1);
+		}
+		const size_t g = index(goal);
+		unsigned cost = 0U;
+		while (i != g)
+		{
+			const uint8_t d = getDir(i);
+			if (d == NoDirection)
+			{
+				return unsigned(-1);
+			}
+			cost += DirectionCost(d);
+			i = step(i);
+		}
+		return cost;
+	}
+
+	inline unsigned FlowField::distance(FDistances & D, size_t i) const
+	{
+		if (!D.dense.empty())
+		{
+			return D.dense[i];
+		}
+		const std::unordered_map<size_t, unsigned>::const_iterator known = D.sparse.find(i);
+		if (known != D.sparse.end())
+		{
+			return known->second;
+		}
+
+		// the voxels on the way to the first one met before, or to the goal, all get their distances
+		std::vector<size_t> chain;
+		const size_t g = index(goal);
+		unsigned d = unsigned(-1);
+		for (size_t j = i;; j = step(j))
+		{
+			const std::unordered_map<size_t, unsigned>::const_iterator met = D.sparse.find(j);
+			if (met != D.sparse.end())
+			{
+				d = met->second;
+				break;
+			}
+			if (j == g && goalOpen)
+			{
+				d = 0U;
+				break;
+			}
+			if (getDir(j) == NoDirection)
+			{
+				break;
+			}
+			chain.push_back(j);
+		}
+		if (chain.empty())
+		{
+			// i itself ended the walk
+			D.sparse[i] = d;
+			return d;
+		}
+		for (size_t k = chain.size(); k-- > 0;)
+		{
+			if (d != unsigned(-1))
+			{
+				d += DirectionCost(getDir(chain[k]));
+			}
+			D.sparse[chain[k]] = d;
+		}
+		return D.sparse[i];
+	}
+
+	inline std::vector<FPosition> FlowField::FollowPath(FPosition Start) const
+	{
+		std::vector<FPosition> path;
+		if (!Contains(Start) || !goalOpen || (Start != goal && getDir(index(Start)) == NoDirection))
+		{
+			return path;
+		}
+
+		path.push_back(Start);
+		uint8_t last = NoDirection;
+		FPosition p = Start;
+		while (p != goal)
+		{
+			const uint8_t d = Direction(p);
+			if (d == NoDirection)
+			{
+				return std::vector<FPosition>();
+			}
+			if (d != last && p != Start)
+			{
+				path.push_back(p);
+			}
+			last = d;
+			p = Next(p);
+		}
+		path.push_back(goal);
+		return path;
+	}
+
+	inline void FlowField::sweep(Queue & open, FDistances & D)
+	{
+		while (!open.empty())
+		{
+			const QueueItem top = open.top();
+			open.pop();
+			if (top.first != distance(D, top.second))
+			{
+				// outdated entry
+				continue;
+			}
+
+			const FPosition p = position(top.second);
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				const FPosition n(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+				if (!passable(n) || !CanMove(grid, p.x, p.y, p.z, d, dMove))
+				{
+					continue;
+				}
+				const size_t i = index(n);
+				const unsigned nd = top.first + DirectionCost(d);
+				if (nd < distance(D, i))
+				{
+					settle(D, i, nd);
+					// the step back from n leads to p
+					setDir(i, uint8_t(OppositeDirection(d)));
+					open.push(QueueItem(nd, i));
+				}
+			}
+		}
+	}
+
+}
+
+#endif // !FLOW_FIELD_H
\ No newline at end of file
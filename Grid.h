@@ -2,35 +2,58 @@
 #define GRID_H
 
 #include <map>
+#include <memory>
+#include <algorithm>
 #include <vector>
 #include <string>
 
 #include "Position.h"
 
+// for the passability tests that run for every voxel a jump visits, which have to be inlined whatever their size
+#ifndef JPS_FORCEINLINE
+#if defined(_MSC_VER)
+#define JPS_FORCEINLINE __forceinline
+#else
+#define JPS_FORCEINLINE inline __attribute__((always_inline))
+#endif
+#endif
+
 namespace JPS {
 
 	struct FGrid
 	{
+		// bricks of 16x16x16 voxels, the unit the acceleration structures work and invalidate in
+		static const unsigned BrickShift = 4U;
+		static const unsigned BrickSize = 1U << BrickShift;
+		// a cell is a bitfield of passability classes, the plain test treats any of them as free
+		static const int AllClasses = ~0;
+
 		unsigned x, y, z;
 		FPosition start, finish;
-		std::vector<std::vector<std::vector<int>>> lines;
+		/*
+			Copies of a grid share the lines of x voxels until one of them writes, so a copy costs a pointer per line
+			and an edit of the copy the lines it changes; an owner may also keep a line in memory the grid did not allocate alive.
+			SetCell decides by the use count of the owner whether a line is shared, which is exact only while every copy
+			that shares a line is made, edited and destroyed by one thread, as GridSnapshots keeps them; the count is not synchronizing,
+			so copies edited by different threads must not share lines
+		*/
+		std::vector<std::vector<int *>> lines;
+		std::vector<std::vector<std::shared_ptr<int>>> owners;
 
 		FGrid() {}
 		FGrid(const std::string filename)
 		{
 
 		}
-		FGrid(const unsigned xx, const unsigned yy, const unsigned zz, int * cells) : x(xx), y(yy), z(zz), lines(z, std::vector<std::vector<int>>(y, std::vector<int>(x)))
+		FGrid(const unsigned xx, const unsigned yy, const unsigned zz, int * cells) : x(xx), y(yy), z(zz), lines(z, std::vector<int *>(y)), owners(z, std::vector<std::shared_ptr<int>>(y))
 		{
 			for (unsigned i = 0; i < z; ++i)
 			{
 				for (unsigned j = 0; j < y; ++j)
 				{
-					for (unsigned k = 0; k < x; ++k)
-					{
-						lines[i][j][k] = *cells;
-						++cells;
-					}
+					owners[i][j] = newLine(cells);
+					lines[i][j] = owners[i][j].get();
+					cells += x;
 				}
 			}
 		}
@@ -39,6 +62,8 @@ namespace JPS {
 		{
 			lines.clear();
 			lines.shrink_to_fit();
+			owners.clear();
+			owners.shrink_to_fit();
 		}
 
 		inline void SetStart(FPosition p)
@@ -51,6 +76,63 @@ namespace JPS {
 			finish = p;
 		}
 
+		inline void SetCell(unsigned xx, unsigned yy, unsigned zz, int value)
+		{
+			if (xx < x && yy < y && zz < z)
+			{
+				// a line another copy still reads is copied first; see the single writer rule above
+				std::shared_ptr<int> & owner = owners[zz][yy];
+				if (owner.use_count() > 1)
+				{
+					owner = newLine(owner.get());
+					lines[zz][yy] = owner.get();
+				}
+				lines[zz][yy][xx] = value;
+			}
+		}
+
+		inline void SetCell(FPosition p, int value)
+		{
+			SetCell(p.x, p.y, p.z, value);
+		}
+
+		// a line of its own with the x values from cells
+		inline std::shared_ptr<int> newLine(const int * cells) const
+		{
+			std::shared_ptr<int> line(new int[x], std::default_delete<int[]>());
+			std::copy(cells, cells + x, line.get());
+			return line;
+		}
+
+#pragma region Bricks
+
+		inline unsigned BricksX() const
+		{
+			return (x + BrickSize - 1) >> BrickShift;
+		}
+
+		inline unsigned BricksY() const
+		{
+			return (y + BrickSize - 1) >> BrickShift;
+		}
+
+		inline unsigned BricksZ() const
+		{
+			return (z + BrickSize - 1) >> BrickShift;
+		}
+
+		inline unsigned BrickIndex(unsigned xx, unsigned yy, unsigned zz) const
+		{
+			return ((zz >> BrickShift) * BricksY() + (yy >> BrickShift)) * BricksX() + (xx >> BrickShift);
+		}
+
+		inline unsigned BrickIndex(FPosition p) const
+		{
+			return BrickIndex(p.x, p.y, p.z);
+		}
+
+#pragma endregion
+
 #pragma region Operator()
 
 		inline bool operator()(unsigned xx, unsigned yy, unsigned zz) const
@@ -67,6 +149,21 @@ namespace JPS {
 			return operator()(p.x, p.y, p.z);
 		}
 
+		// free for an agent of any of the passability classes Classes
+		inline bool IsPassable(unsigned xx, unsigned yy, unsigned zz, int Classes) const
+		{
+			if (xx < x && yy < y && zz < z)
+			{
+				return (lines[zz][yy][xx] & Classes) != 0;
+			}
+			return false;
+		}
+
+		inline bool IsPassable(FPosition p, int Classes) const
+		{
+			return IsPassable(p.x, p.y, p.z, Classes);
+		}
+
 #pragma endregion
 
 	};
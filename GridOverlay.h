@@ -0,0 +1,195 @@
+#ifndef GRID_OVERLAY_H
+#define GRID_OVERLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Sparse per-query edits on top of a shared grid, such as the voxels other agents stand in:
+		a voxel can be blocked or freed without touching the grid. Only the bricks with edits get a bitmask,
+		one bit per voxel for the edit and one for its kind, so the lookup in a brick without edits is a single load
+		and in any other one a bit test
+	*/
+	class GridOverlay
+	{
+
+	public:
+
+		enum EState
+		{
+			Unset,
+			Blocked,
+			Freed
+		};
+
+		GridOverlay(const FGrid & g) : grid(g), shiftX(log2(g.BricksX())), shiftXY(shiftX + log2(g.BricksY())), size(0U), freed(0U)
+		{
+			slots.assign(size_t(g.BricksZ()) << shiftXY, 0U);
+		}
+
+		inline void Block(const FPosition & p)
+		{
+			set(p, Blocked);
+		}
+
+		inline void Free(const FPosition & p)
+		{
+			set(p, Freed);
+		}
+
+		// drops the edit of the voxel, so the grid decides again
+		inline void Remove(const FPosition & p)
+		{
+			set(p, Unset);
+		}
+
+		inline void Clear()
+		{
+			std::fill(slots.begin(), slots.end(), 0U);
+			bits.clear();
+			size = 0U;
+			freed = 0U;
+		}
+
+		inline bool Empty() const
+		{
+			return size == 0U;
+		}
+
+		inline unsigned Size() const
+		{
+			return size;
+		}
+
+		// whether a voxel is freed, which can join parts the grid keeps apart; blocking only ever splits them
+		inline bool FreesAny() const
+		{
+			return freed != 0U;
+		}
+
+		// whether the brick of a voxel inside the grid has edits, a single load
+		JPS_FORCEINLINE bool InEditedBrick(unsigned x, unsigned y, unsigned z) const
+		{
+			return slots[brick(x, y, z)] != 0U;
+		}
+
+		// Unset for the voxels the overlay does not change and the voxels outside the grid
+		inline EState Lookup(unsigned x, unsigned y, unsigned z) const
+		{
+			if (x >= grid.x || y >= grid.y || z >= grid.z)
+			{
+				return Unset;
+			}
+			const unsigned slot = slots[brick(x, y, z)];
+			if (!slot)
+			{
+				return Unset;
+			}
+			const unsigned i = voxel(x, y, z);
+			const uint64_t * w = &bits[size_t(slot - 1) * SlotWords];
+			if (!((w[i >> 6] >> (i & 63)) & 1ULL))
+			{
+				return Unset;
+			}
+			return (w[VoxelWords + (i >> 6)] >> (i & 63)) & 1ULL ? Freed : Blocked;
+		}
+
+		inline EState Lookup(const FPosition & p) const
+		{
+			return Lookup(p.x, p.y, p.z);
+		}
+
+		// the grid with the overlay applied, for any of the passability classes Classes
+		inline bool IsPassable(unsigned x, unsigned y, unsigned z, int Classes = FGrid::AllClasses) const
+		{
+			const EState s = Lookup(x, y, z);
+			return s == Unset ? grid.IsPassable(x, y, z, Classes) : s == Freed;
+		}
+
+	private:
+
+		static const unsigned VoxelWords = (FGrid::BrickSize * FGrid::BrickSize * FGrid::BrickSize) / 64U;
+		// the edit bits of a brick, then the freed bits
+		static const unsigned SlotWords = 2U * VoxelWords;
+
+		const FGrid & grid;
+		// the brick rows and slices are padded to powers of two, so the brick of a voxel is found with shifts only
+		unsigned shiftX, shiftXY;
+		// per brick, 0 without edits, else one past its bitmask in bits
+		std::vector<unsigned> slots;
+		std::vector<uint64_t> bits;
+		unsigned size;
+		unsigned freed;
+
+		JPS_FORCEINLINE unsigned brick(unsigned x, unsigned y, unsigned z) const
+		{
+			return (z >> FGrid::BrickShift << shiftXY) | (y >> FGrid::BrickShift << shiftX) | (x >> FGrid::BrickShift);
+		}
+
+		// the smallest s with 2^s >= n
+		static inline unsigned log2(unsigned n)
+		{
+			unsigned s = 0U;
+			while ((1U << s) < n)
+			{
+				++s;
+			}
+			return s;
+		}
+
+		inline unsigned voxel(unsigned x, unsigned y, unsigned z) const
+		{
+			const unsigned m = FGrid::BrickSize - 1U;
+			return (((z & m) << FGrid::BrickShift | (y & m)) << FGrid::BrickShift) | (x & m);
+		}
+
+		inline void set(const FPosition & p, EState s)
+		{
+			if (p.x >= grid.x || p.y >= grid.y || p.z >= grid.z)
+			{
+				return;
+			}
+			unsigned & slot = slots[brick(p.x, p.y, p.z)];
+			if (!slot)
+			{
+				if (s == Unset)
+				{
+					return;
+				}
+				bits.resize(bits.size() + SlotWords, 0ULL);
+				slot = unsigned(bits.size() / SlotWords);
+			}
+
+			const unsigned i = voxel(p.x, p.y, p.z);
+			uint64_t * w = &bits[size_t(slot - 1) * SlotWords];
+			const uint64_t bit = 1ULL << (i & 63);
+			uint64_t & edit = w[i >> 6];
+			uint64_t & kind = w[VoxelWords + (i >> 6)];
+			if (edit & bit)
+			{
+				--size;
+				freed -= kind & bit ? 1U : 0U;
+			}
+			edit &= ~bit;
+			kind &= ~bit;
+			if (s != Unset)
+			{
+				edit |= bit;
+				kind |= s == Freed ? bit : 0ULL;
+				++size;
+				freed += s == Freed ? 1U : 0U;
+			}
+		}
+
+	};
+
+}
+
+#endif // !GRID_OVERLAY_H
\ No newline at end of file
@@ -0,0 +1,251 @@
+#ifndef GRID_SNAPSHOTS_H
+#define GRID_SNAPSHOTS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Versions of a grid that one writer edits while any number of searches read: a query pins the current version and searches it
+		from start to end, the writer edits its own copy and publishes it as the next version without waiting for the readers.
+		The versions share every line of voxels no edit has touched, a version the readers may still hold is retired and freed
+		once every pin taken before it was replaced has been released (epoch-based reclamation), which frees the lines only it used.
+		Pinning is a store and a load on the reader side; a Searcher searches a pinned version through SetGrid, the structures
+		built over a grid (clearance, hierarchy, cache) describe the version they were built on
+	*/
+	class GridSnapshots
+	{
+
+		struct FVersion;
+
+	public:
+
+		// a pinned version, released by the destructor; the grid stays unchanged until then
+		class Snapshot
+		{
+
+		public:
+
+			Snapshot() {}
+
+			Snapshot(Snapshot && Other) : slot(Other.slot), version(Other.version)
+			{
+				Other.slot = NULL;
+				Other.version = NULL;
+			}
+
+			inline Snapshot & operator=(Snapshot && Other)
+			{
+				if (this != &Other)
+				{
+					Release();
+					std::swap(slot, Other.slot);
+					std::swap(version, Other.version);
+				}
+				return *this;
+			}
+
+			Snapshot(const Snapshot &) = delete;
+			Snapshot & operator=(const Snapshot &) = delete;
+
+			~Snapshot()
+			{
+				Release();
+			}
+
+			inline void Release()
+			{
+				if (slot)
+				{
+					slot->store(0U);
+				}
+				slot = NULL;
+				version = NULL;
+			}
+
+			inline explicit operator bool() const
+			{
+				return version != NULL;
+			}
+
+			inline const FGrid & Grid() const
+			{
+				return version->grid;
+			}
+
+			// 1 for the grid the snapshots were made of, one more for every Publish
+			inline unsigned Version() const
+			{
+				return version->number;
+			}
+
+		private:
+
+			friend class GridSnapshots;
+
+			std::atomic<uint64_t> * slot = NULL;
+			const FVersion * version = NULL;
+
+		};
+
+		// MaxReaders snapshots may be pinned at once, a further Pin waits for one of them to be released
+		GridSnapshots(const FGrid & g, unsigned MaxReaders = 64U);
+
+		// every snapshot must be released before
+		~GridSnapshots();
+
+		GridSnapshots(const GridSnapshots &) = delete;
+		GridSnapshots & operator=(const GridSnapshots &) = delete;
+
+		// any thread; never waits for the writer
+		Snapshot Pin();
+
+#pragma region Writer
+
+		// the writer is one thread at a time; its edits stay invisible to the readers until Publish
+
+		inline void SetCell(unsigned xx, unsigned yy, unsigned zz, int value)
+		{
+			working.SetCell(xx, yy, zz, value);
+		}
+
+		inline void SetCell(FPosition p, int value)
+		{
+			working.SetCell(p, value);
+		}
+
+		// the grid with the edits not published yet
+		inline const FGrid & GetWorking() const
+		{
+			return working;
+		}
+
+		// makes the edits the current version, the later pins search it; returns its number
+		unsigned Publish();
+
+		// frees the retired versions no snapshot holds any more, Publish does so too
+		void Collect();
+
+		// versions retired and not freed yet
+		inline size_t GetRetired() const
+		{
+			return retired.size();
+		}
+
+#pragma endregion
+
+	private:
+
+		struct FVersion
+		{
+			FVersion(const FGrid & g, unsigned n) : grid(g), number(n) {}
+
+			FGrid grid;
+			unsigned number;
+			// the epoch the version was replaced in
+			uint64_t retiredIn = 0U;
+		};
+
+		// a reader slot holds the epoch its pin started in, 0 when free; one cache line each, so pinning does not contend
+		struct FSlot
+		{
+			std::atomic<uint64_t> epoch{ 0U };
+			char padding[64 - sizeof(std::atomic<uint64_t>)];
+		};
+
+		FGrid working;
+		std::atomic<const FVersion *> current{ NULL };
+		std::atomic<uint64_t> epoch{ 1U };
+		std::unique_ptr<FSlot[]> slots;
+		unsigned slotCount;
+		std::vector<FVersion *> retired;
+		unsigned published = 1U;
+
+	};
+
+	inline GridSnapshots::GridSnapshots(const FGrid & g, unsigned MaxReaders) :
+		working(g), slots(new FSlot[std::max(MaxReaders, 1U)]), slotCount(std::max(MaxReaders, 1U))
+	{
+		current = new FVersion(working, published);
+	}
+
+	inline GridSnapshots::~GridSnapshots()
+	{
+		delete current.load();
+		for (unsigned i = 0; i < retired.size(); ++i)
+		{
+			delete retired[i];
+		}
+	}
+
+	inline GridSnapshots::Snapshot GridSnapshots::Pin()
+	{
+		Snapshot s;
+		const uint64_t e = epoch.load();
+		for (unsigned i = 0; !s.slot; i = (i + 1U) % slotCount)
+		{
+			uint64_t expected = 0U;
+			if (slots[i].epoch.compare_exchange_strong(expected, e))
+			{
+				s.slot = &slots[i].epoch;
+			}
+			else if (i + 1U == slotCount)
+			{
+				std::this_thread::yield();
+			}
+		}
+		// the slot is set before the version is read: a version replaced after the epoch e stays until the slot is released
+		s.version = current.load();
+		return s;
+	}
+
+	inline unsigned GridSnapshots::Publish()
+	{
+		FVersion * next = new FVersion(working, ++published);
+		FVersion * old = const_cast<FVersion *>(current.exchange(next));
+		// a pin that reads the epoch after the increment reads the new version too
+		old->retiredIn = epoch.fetch_add(1U) + 1U;
+		retired.push_back(old);
+		Collect();
+		return published;
+	}
+
+	inline void GridSnapshots::Collect()
+	{
+		uint64_t oldest = UINT64_MAX;
+		for (unsigned i = 0; i < slotCount; ++i)
+		{
+			const uint64_t e = slots[i].epoch.load();
+			if (e)
+			{
+				oldest = std::min(oldest, e);
+			}
+		}
+		size_t kept = 0U;
+		for (size_t i = 0; i < retired.size(); ++i)
+		{
+			if (retired[i]->retiredIn <= oldest)
+			{
+				delete retired[i];
+			}
+			else
+			{
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+	}
+
+}
+
+#endif // !GRID_SNAPSHOTS_H
\ No newline at end of file
@@ -0,0 +1,201 @@
+#ifndef GRID_VIEW_H
+#define GRID_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+#include "SearchMask.h"
+#include "Clearance.h"
+#include "GridOverlay.h"
+
+namespace JPS {
+
+	/*
+		What the searcher sees of a grid: a voxel is passable if the grid has it free and every restriction
+		of the current query admits it; the jumps only ever ask the view, so a restriction
+		stops them at its border and the nodes behind it are never allocated
+	*/
+	struct FGridView
+	{
+		FGridView(const FGrid & g) : grid(&g), mask(NULL), inner(NULL), slow(NULL), clearance(NULL), radius(0U), classes(FGrid::AllClasses),
+			overlay(NULL), edits(false)
+		{
+			SetMask(NULL);
+		}
+
+		inline const FGrid & Base() const
+		{
+			return *grid;
+		}
+
+		inline void SetGrid(const FGrid & g)
+		{
+			grid = &g;
+			SetMask(mask, inner);
+		}
+
+		/*
+			The box of the mask replaces the bounds test of the grid, so an unrestricted view costs what the grid does;
+			Inner restricts the view further, for the searches of a part of the grid the caller's mask still applies to:
+			the boxes are intersected, the bits of one of the masks are read inline and those of the other through Contains.
+			The bits are taken when the mask is set, so it must not be edited while the view holds it
+		*/
+		inline void SetMask(const SearchMask * m, const SearchMask * Inner = NULL)
+		{
+			mask = m;
+			inner = Inner;
+			FPosition lo = m ? m->GetMin() : FPosition(0, 0, 0);
+			FPosition hi = m ? m->GetMax() : FPosition(grid->x - 1, grid->y - 1, grid->z - 1);
+			if (inner)
+			{
+				lo = FPosition(std::max(lo.x, inner->GetMin().x), std::max(lo.y, inner->GetMin().y), std::max(lo.z, inner->GetMin().z));
+				hi = FPosition(std::min(hi.x, inner->GetMax().x), std::min(hi.y, inner->GetMax().y), std::min(hi.z, inner->GetMax().z));
+			}
+			minX = lo.x;
+			minY = lo.y;
+			minZ = lo.z;
+			// a box past the border of the grid is cut to it, the cells are read without another test; disjoint boxes leave nothing
+			sizeX = lo.x > hi.x ? 0U : (hi.x < grid->x ? hi.x - lo.x + 1 : (lo.x < grid->x ? grid->x - lo.x : 0U));
+			sizeY = lo.y > hi.y ? 0U : (hi.y < grid->y ? hi.y - lo.y + 1 : (lo.y < grid->y ? grid->y - lo.y : 0U));
+			sizeZ = lo.z > hi.z ? 0U : (hi.z < grid->z ? hi.z - lo.z + 1 : (lo.z < grid->z ? grid->z - lo.z : 0U));
+
+			const SearchMask * fast = m && m->GetBits() ? m : (inner && inner->GetBits() ? inner : NULL);
+			slow = fast == m && inner && inner->GetBits() ? inner : NULL;
+			bits = fast ? fast->GetBits() : NULL;
+			maskX = fast ? fast->GetMax().x - fast->GetMin().x + 1 : 0U;
+			maskY = fast ? fast->GetMax().y - fast->GetMin().y + 1 : 0U;
+			// the bit of the voxel at the corner of the box, which may lie inside the box of the masks
+			bitBase = fast && sizeX && sizeY && sizeZ ?
+				(size_t(lo.z - fast->GetMin().z) * maskY + (lo.y - fast->GetMin().y)) * maskX + (lo.x - fast->GetMin().x) : 0U;
+			edits = overlay || (clearance && radius) || slow;
+		}
+
+		inline const SearchMask * GetMask() const
+		{
+			return mask;
+		}
+
+		inline const SearchMask * GetInnerMask() const
+		{
+			return inner;
+		}
+
+		// an agent of radius Radius only stands where it fits, the clearance test replaces the cell test
+		inline void SetClearance(const Clearance * c, unsigned Radius)
+		{
+			clearance = c;
+			radius = Radius;
+			edits = overlay || (clearance && radius) || slow;
+		}
+
+		inline const Clearance * GetClearance() const
+		{
+			return clearance;
+		}
+
+		inline unsigned GetRadius() const
+		{
+			return radius;
+		}
+
+		// the passability classes of the agent, a voxel is free if its cell shares one of them
+		inline void SetClasses(int Classes)
+		{
+			classes = Classes;
+		}
+
+		inline int GetClasses() const
+		{
+			return classes;
+		}
+
+		// voxels blocked or freed for the current queries only, applied before the clearance and the mask
+		inline void SetOverlay(const GridOverlay * o)
+		{
+			overlay = o;
+			edits = overlay || (clearance && radius) || slow;
+		}
+
+		inline const GridOverlay * GetOverlay() const
+		{
+			return overlay;
+		}
+
+		// whether the view differs from the bare grid; radius 0 fits wherever the voxel is free, an empty overlay changes nothing
+		inline bool IsRestricted() const
+		{
+			return mask || inner || (clearance && radius) || classes != FGrid::AllClasses || (overlay && !overlay->Empty());
+		}
+
+#pragma region Operator()
+
+		JPS_FORCEINLINE bool operator()(unsigned xx, unsigned yy, unsigned zz) const
+		{
+			const unsigned rx = xx - minX;
+			const unsigned ry = yy - minY;
+			const unsigned rz = zz - minZ;
+			if (rx >= sizeX || ry >= sizeY || rz >= sizeZ)
+			{
+				return false;
+			}
+			if (edits)
+			{
+				return edited(xx, yy, zz) && (!bits || admits(rx, ry, rz));
+			}
+			return (grid->lines[zz][yy][xx] & classes) != 0 && (!bits || admits(rx, ry, rz));
+		}
+
+		JPS_FORCEINLINE bool operator()(FPosition p) const
+		{
+			return operator()(p.x, p.y, p.z);
+		}
+
+#pragma endregion
+
+	private:
+
+		const FGrid * grid;
+		const SearchMask * mask;
+		const SearchMask * inner;
+		// the mask whose bits are read through Contains, when both have bits
+		const SearchMask * slow;
+		const Clearance * clearance;
+		unsigned radius;
+		int classes;
+		const GridOverlay * overlay;
+		// whether the overlay, the clearance or the slow mask take part
+		bool edits;
+		unsigned minX, minY, minZ;
+		unsigned sizeX, sizeY, sizeZ;
+		unsigned maskX, maskY;
+		size_t bitBase;
+		const uint64_t * bits;
+
+		// the overlay, the clearance and the slow mask
+		bool edited(unsigned xx, unsigned yy, unsigned zz) const;
+
+		JPS_FORCEINLINE bool admits(unsigned rx, unsigned ry, unsigned rz) const
+		{
+			const size_t i = (size_t(rz) * maskY + ry) * maskX + rx + bitBase;
+			return !!((bits[i >> 6] >> (i & 63)) & 1ULL);
+		}
+
+	};
+
+	JPS_FORCEINLINE bool FGridView::edited(unsigned xx, unsigned yy, unsigned zz) const
+	{
+		// a voxel of a brick without edits skips the lookup
+		const GridOverlay::EState edit = overlay && overlay->InEditedBrick(xx, yy, zz) ? overlay->Lookup(xx, yy, zz) : GridOverlay::Unset;
+		if (edit == GridOverlay::Blocked || (edit == GridOverlay::Unset && (grid->lines[zz][yy][xx] & classes) == 0))
+		{
+			return false;
+		}
+		return (!radius || !clearance || clearance->FitsInside(xx, yy, zz, radius)) && (!slow || slow->Contains(xx, yy, zz));
+	}
+
+}
+
+#endif // !GRID_VIEW_H
\ No newline at end of file
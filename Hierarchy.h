@@ -0,0 +1,525 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <cmath>
+#include <map>
+#include <set>
+#include <queue>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+#include "Searcher.h"
+#include "SearchMask.h"
+
+namespace JPS {
+
+	/*
+		HPA*-style abstraction: the grid is split into clusters of ClusterSize^3 voxels, every free stretch
+		of a face between two clusters gets a pair of entrance nodes, and the entrances of one cluster are
+		joined by the paths the JPS searcher finds inside it; a query searches the small abstract graph
+		and stitches the stored cluster paths together, so the flat search only runs inside the start
+		and the finish clusters
+	*/
+	class Hierarchy
+	{
+
+	public:
+
+		Hierarchy(const FGrid & g, Searcher & s, unsigned ClusterSize = 32U) :
+			grid(g), searcher(s), size(std::max(ClusterSize, 2U)) {}
+
+		void Build();
+
+		// rebuilds only the clusters holding the cells at Changed and the entrances on their faces
+		void Update(const std::vector<FPosition> & Changed);
+
+		/*
+			Returns: 1) empty vector - the path does not exist
+					 2) vector with the only element - the start and the finish match
+					 3) vector with the start, the waypoints and the finish, every two neighbours on a straight line
+		*/
+		std::vector<FPosition> FindPath(FPosition Start, FPosition Finish);
+
+		inline unsigned NodeCount() const
+		{
+			unsigned n = 0U;
+			for (std::map<unsigned, std::vector<FPosition>>::const_iterator it = nodes.begin(); it != nodes.end(); ++it)
+			{
+				n += unsigned(it->second.size());
+			}
+			return n;
+		}
+
+	private:
+
+		// the side of a square of a face that gets at most one entrance per free stretch
+		static const unsigned EntranceTile = 8U;
+
+		struct FEdge
+		{
+			FPosition a, b;
+			float cost;
+			std::vector<FPosition> path;
+		};
+
+		// face between the cluster and its neighbour along the axis (0 - x, 1 - y, 2 - z)
+		typedef std::pair<unsigned, unsigned> FaceKey;
+		typedef std::vector<std::pair<FPosition, FPosition>> Entrances;
+
+		const FGrid & grid;
+		Searcher & searcher;
+		unsigned size;
+		unsigned cx = 0U, cy = 0U, cz = 0U;
+		std::map<FaceKey, Entrances> faces;
+		std::map<unsigned, std::vector<FPosition>> nodes;
+		std::map<unsigned, std::vector<FEdge>> intra;
+		std::multimap<FPosition, FPosition> inter;
+
+		inline unsigned clusterOf(const FPosition & p) const
+		{
+			return ((p.z / size) * cy + p.y / size) * cx + p.x / size;
+		}
+
+		inline bool inCluster(const FPosition & p, unsigned c) const
+		{
+			return p.x < grid.x && p.y < grid.y && p.z < grid.z && clusterOf(p) == c;
+		}
+
+		static inline float length(const FPosition & a, const FPosition & b)
+		{
+			const float dx = float(int(a.x - b.x));
+			const float dy = float(int(a.y - b.y));
+			const float dz = float(int(a.z - b.z));
+			return sqrtf(dx * dx + dy * dy + dz * dz);
+		}
+
+		void buildFace(const FaceKey & f);
+		void buildCluster(unsigned c);
+		void collectNodes(unsigned c);
+		void rebuildInter();
+		bool clusterPath(const FPosition & a, const FPosition & b, unsigned c, FEdge & e) const;
+
+	};
+
+	inline void Hierarchy::Build()
+	{
+		cx = (grid.x + size - 1) / size;
+		cy = (grid.y + size - 1) / size;
+		cz = (grid.z + size - 1) / size;
+		faces.clear();
+		nodes.clear();
+		intra.clear();
+
+		const unsigned count = cx * cy * cz;
+		for (unsigned c = 0; c < count; ++c)
+		{
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				buildFace(FaceKey(c, axis));
+			}
+		}
+		for (unsigned c = 0; c < count; ++c)
+		{
+			collectNodes(c);
+		}
+		for (unsigned c = 0; c < count; ++c)
+		{
+			buildCluster(c);
+		}
+		rebuildInter();
+	}
+
+	inline void Hierarchy::Update(const std::vector<FPosition> & Changed)
+	{
+		if (!cx)
+		{
+			Build();
+			return;
+		}
+
+		// clusters whose voxels changed, plus the neighbours sharing a face layer with a changed voxel
+		std::set<unsigned> dirty;
+		for (unsigned i = 0; i < Changed.size(); ++i)
+		{
+			const FPosition & p = Changed[i];
+			for (int dz = -1; dz <= 1; ++dz)
+			{
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						const FPosition n(p.x + dx, p.y + dy, p.z + dz);
+						if (n.x < grid.x && n.y < grid.y && n.z < grid.z)
+						{
+							dirty.insert(clusterOf(n));
+						}
+					}
+				}
+			}
+		}
+
+		// the faces of the dirty clusters, the clusters on their other side need new cluster paths too
+		std::set<unsigned> rebuild(dirty);
+		const unsigned step[3] = { 1U, cx, cx * cy };
+		for (std::set<unsigned>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
+		{
+			const unsigned c = *it;
+			const unsigned coord[3] = { c % cx, (c / cx) % cy, c / (cx * cy) };
+			const unsigned limit[3] = { cx, cy, cz };
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				buildFace(FaceKey(c, axis));
+				if (coord[axis] + 1 < limit[axis])
+				{
+					rebuild.insert(c + step[axis]);
+				}
+				if (coord[axis] > 0)
+				{
+					buildFace(FaceKey(c - step[axis], axis));
+					rebuild.insert(c - step[axis]);
+				}
+			}
+		}
+
+		for (std::set<unsigned>::const_iterator it = rebuild.begin(); it != rebuild.end(); ++it)
+		{
+			collectNodes(*it);
+		}
+		for (std::set<unsigned>::const_iterator it = rebuild.begin(); it != rebuild.end(); ++it)
+		{
+			buildCluster(*it);
+		}
+		rebuildInter();
+	}
+
+	inline std::vector<FPosition> Hierarchy::FindPath(FPosition Start, FPosition Finish)
+	{
+		std::vector<FPosition> path;
+		if (!grid(Start) || !grid(Finish))
+		{
+			// 1) the path does not exist
+			return path;
+		}
+		if (Start == Finish)
+		{
+			// 2) the start and the finish match
+			path.push_back(Start);
+			return path;
+		}
+		if (!cx)
+		{
+			Build();
+		}
+
+		const unsigned cs = clusterOf(Start);
+		const unsigned cf = clusterOf(Finish);
+
+		// temporary edges from the start and to the finish
+		std::vector<FEdge> local;
+		FEdge e;
+		if (cs == cf && clusterPath(Start, Finish, cs, e))
+		{
+			local.push_back(e);
+		}
+		const std::vector<FPosition> & ns = nodes[cs];
+		for (unsigned i = 0; i < ns.size(); ++i)
+		{
+			if (clusterPath(Start, ns[i], cs, e))
+			{
+				local.push_back(e);
+			}
+		}
+		const std::vector<FPosition> & nf = nodes[cf];
+		for (unsigned i = 0; i < nf.size(); ++i)
+		{
+			if (clusterPath(nf[i], Finish, cf, e))
+			{
+				local.push_back(e);
+			}
+		}
+
+		// A* over the abstract graph; an edge is (cluster path index or inter-cluster step)
+		typedef std::pair<float, FPosition> QueueItem;
+		std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+		std::map<FPosition, float> g;
+		std::map<FPosition, std::pair<FPosition, const FEdge *>> parent;
+		std::set<FPosition> closed;
+
+		g[Start] = 0.0f;
+		open.push(QueueItem(length(Start, Finish), Start));
+		bool found = false;
+		while (!open.empty())
+		{
+			const FPosition cur = open.top().second;
+			open.pop();
+			if (!closed.insert(cur).second)
+			{
+				continue;
+			}
+			if (cur == Finish)
+			{
+				found = true;
+				break;
+			}
+			const float gc = g[cur];
+
+			// (target, cost, stored path)
+			std::vector<std::pair<FPosition, std::pair<float, const FEdge *>>> next;
+			for (unsigned i = 0; i < local.size(); ++i)
+			{
+				if (local[i].a == cur)
+				{
+					next.push_back(std::make_pair(local[i].b, std::make_pair(local[i].cost, &local[i])));
+				}
+			}
+			const std::vector<FEdge> & edges = intra[clusterOf(cur)];
+			for (unsigned i = 0; i < edges.size(); ++i)
+			{
+				if (edges[i].a == cur)
+				{
+					next.push_back(std::make_pair(edges[i].b, std::make_pair(edges[i].cost, &edges[i])));
+				}
+				else if (edges[i].b == cur)
+				{
+					// the stored path is walked backwards while stitching
+					next.push_back(std::make_pair(edges[i].a, std::make_pair(edges[i].cost, &edges[i])));
+				}
+			}
+			std::pair<std::multimap<FPosition, FPosition>::const_iterator, std::multimap<FPosition, FPosition>::const_iterator> range = inter.equal_range(cur);
+			for (std::multimap<FPosition, FPosition>::const_iterator it = range.first; it != range.second; ++it)
+			{
+				next.push_back(std::make_pair(it->second, std::make_pair(length(cur, it->second), (const FEdge *)NULL)));
+			}
+
+			for (unsigned i = 0; i < next.size(); ++i)
+			{
+				const FPosition & n = next[i].first;
+				const float ng = gc + next[i].second.first;
+				std::map<FPosition, float>::iterator old = g.find(n);
+				if (closed.count(n) || (old != g.end() && old->second <= ng))
+				{
+					continue;
+				}
+				g[n] = ng;
+				parent[n] = std::make_pair(cur, next[i].second.second);
+				open.push(QueueItem(ng + length(n, Finish), n));
+			}
+		}
+
+		if (!found)
+		{
+			// 1) the path does not exist
+			return path;
+		}
+
+		// 3) stitch the cluster paths of the abstract path together
+		std::vector<std::pair<FPosition, const FEdge *>> chain;
+		for (FPosition p = Finish; p != Start; p = parent[p].first)
+		{
+			chain.push_back(std::make_pair(p, parent[p].second));
+		}
+		std::reverse(chain.begin(), chain.end());
+
+		path.push_back(Start);
+		for (unsigned i = 0; i < chain.size(); ++i)
+		{
+			const FEdge * edge = chain[i].second;
+			if (!edge)
+			{
+				path.push_back(chain[i].first);
+				continue;
+			}
+			std::vector<FPosition> piece = edge->path;
+			if (piece.front() != path.back())
+			{
+				std::reverse(piece.begin(), piece.end());
+			}
+			path.insert(path.end(), piece.begin() + 1, piece.end());
+		}
+		return path;
+	}
+
+	// pairs of free voxels across the face, one per free stretch inside every entrance tile
+	inline void Hierarchy::buildFace(const FaceKey & f)
+	{
+		faces.erase(f);
+
+		const unsigned c = f.first;
+		const unsigned axis = f.second;
+		const unsigned coord[3] = { c % cx, (c / cx) % cy, c / (cx * cy) };
+		const unsigned dims[3] = { grid.x, grid.y, grid.z };
+		const unsigned plane = (coord[axis] + 1) * size;
+		if (plane >= dims[axis])
+		{
+			return;
+		}
+
+		// u and v are the two axes spanning the face
+		const unsigned ua = axis == 0 ? 1U : 0U;
+		const unsigned va = axis == 2 ? 1U : 2U;
+		const unsigned u0 = coord[ua] * size;
+		const unsigned v0 = coord[va] * size;
+		const unsigned u1 = std::min(u0 + size, dims[ua]);
+		const unsigned v1 = std::min(v0 + size, dims[va]);
+
+		struct Local
+		{
+			static FPosition make(unsigned axis, unsigned ua, unsigned va, unsigned w, unsigned u, unsigned v)
+			{
+				unsigned p[3];
+				p[axis] = w;
+				p[ua] = u;
+				p[va] = v;
+				return FPosition(p[0], p[1], p[2]);
+			}
+		};
+
+		const unsigned width = u1 - u0;
+		std::vector<bool> open((u1 - u0) * (v1 - v0), false);
+		for (unsigned v = v0; v < v1; ++v)
+		{
+			for (unsigned u = u0; u < u1; ++u)
+			{
+				open[(v - v0) * width + (u - u0)] =
+					grid(Local::make(axis, ua, va, plane - 1, u, v)) && grid(Local::make(axis, ua, va, plane, u, v));
+			}
+		}
+
+		Entrances & out = faces[f];
+		std::vector<bool> seen(open.size(), false);
+		for (unsigned i = 0; i < open.size(); ++i)
+		{
+			if (!open[i] || seen[i])
+			{
+				continue;
+			}
+
+			// flood the stretch inside its entrance tile
+			const unsigned tu = (i % width) / EntranceTile;
+			const unsigned tv = (i / width) / EntranceTile;
+			std::vector<unsigned> stretch(1, i);
+			seen[i] = true;
+			for (unsigned k = 0; k < stretch.size(); ++k)
+			{
+				const unsigned u = stretch[k] % width;
+				const unsigned v = stretch[k] / width;
+				const int du[4] = { -1, 1, 0, 0 };
+				const int dv[4] = { 0, 0, -1, 1 };
+				for (unsigned d = 0; d < 4; ++d)
+				{
+					const unsigned nu = u + du[d];
+					const unsigned nv = v + dv[d];
+					const unsigned n = nv * width + nu;
+					if (nu < width && nv < (v1 - v0) && nu / EntranceTile == tu && nv / EntranceTile == tv && open[n] && !seen[n])
+					{
+						seen[n] = true;
+						stretch.push_back(n);
+					}
+				}
+			}
+
+			// the entrance goes through the middle of the stretch
+			const unsigned m = stretch[stretch.size() / 2];
+			out.push_back(std::make_pair(
+				Local::make(axis, ua, va, plane - 1, u0 + m % width, v0 + m / width),
+				Local::make(axis, ua, va, plane, u0 + m % width, v0 + m / width)));
+		}
+	}
+
+	inline void Hierarchy::collectNodes(unsigned c)
+	{
+		std::vector<FPosition> & out = nodes[c];
+		out.clear();
+
+		const unsigned coord[3] = { c % cx, (c / cx) % cy, c / (cx * cy) };
+		const unsigned step[3] = { 1U, cx, cx * cy };
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			std::map<FaceKey, Entrances>::const_iterator mine = faces.find(FaceKey(c, axis));
+			if (mine != faces.end())
+			{
+				for (unsigned i = 0; i < mine->second.size(); ++i)
+				{
+					out.push_back(mine->second[i].first);
+				}
+			}
+			if (coord[axis] > 0)
+			{
+				std::map<FaceKey, Entrances>::const_iterator theirs = faces.find(FaceKey(c - step[axis], axis));
+				if (theirs != faces.end())
+				{
+					for (unsigned i = 0; i < theirs->second.size(); ++i)
+					{
+						out.push_back(theirs->second[i].second);
+					}
+				}
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	inline void Hierarchy::buildCluster(unsigned c)
+	{
+		std::vector<FEdge> & edges = intra[c];
+		edges.clear();
+
+		const std::vector<FPosition> & ns = nodes[c];
+		FEdge e;
+		for (unsigned i = 0; i < ns.size(); ++i)
+		{
+			for (unsigned j = i + 1; j < ns.size(); ++j)
+			{
+				if (clusterPath(ns[i], ns[j], c, e))
+				{
+					edges.push_back(e);
+				}
+			}
+		}
+	}
+
+	inline void Hierarchy::rebuildInter()
+	{
+		inter.clear();
+		for (std::map<FaceKey, Entrances>::const_iterator f = faces.begin(); f != faces.end(); ++f)
+		{
+			for (unsigned i = 0; i < f->second.size(); ++i)
+			{
+				inter.insert(f->second[i]);
+				inter.insert(std::make_pair(f->second[i].second, f->second[i].first));
+			}
+		}
+	}
+
+	/*
+		A JPS path from a to b that never leaves the cluster c;
+		the search is masked to the box of the cluster inside the mask of the searcher, so a pair that is not connected
+		inside it does not flood the grid
+	*/
+	inline bool Hierarchy::clusterPath(const FPosition & a, const FPosition & b, unsigned c, FEdge & e) const
+	{
+		const FPosition lo((c % cx) * size, (c / cx % cy) * size, (c / (cx * cy)) * size);
+		const FPosition hi(std::min(lo.x + size, grid.x) - 1, std::min(lo.y + size, grid.y) - 1, std::min(lo.z + size, grid.z) - 1);
+		e.path = searcher.FindPath(a, b, SearchMask(lo, hi));
+		if (e.path.size() < 2)
+		{
+			return false;
+		}
+
+		e.cost = 0.0f;
+		for (unsigned i = 0; i + 1 < e.path.size(); ++i)
+		{
+			e.cost += length(e.path[i], e.path[i + 1]);
+		}
+		e.a = a;
+		e.b = b;
+		return true;
+	}
+
+}
+
+#endif // !HIERARCHY_H
\ No newline at end of file
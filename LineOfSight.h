@@ -0,0 +1,131 @@
+#ifndef LINE_OF_SIGHT_H
+#define LINE_OF_SIGHT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Directions.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		3D DDA (Amanatides-Woo) walk over the voxels the segment between two voxel centres passes through;
+		the crossings are compared as exact integer fractions, so a segment through an edge or a corner
+		steps diagonally instead of picking a side, and a straight 26-direction segment gives its own voxels
+	*/
+	class VoxelLine
+	{
+
+	public:
+
+		VoxelLine(const FPosition & a, const FPosition & b) : cur(a), last(b)
+		{
+			const unsigned from[3] = { a.x, a.y, a.z };
+			const unsigned to[3] = { b.x, b.y, b.z };
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				delta[k] = from[k] < to[k] ? to[k] - from[k] : from[k] - to[k];
+				sign[k] = from[k] < to[k] ? 1 : -1;
+				taken[k] = 0U;
+			}
+		}
+
+		inline bool Done() const
+		{
+			return cur == last;
+		}
+
+		inline const FPosition & Current() const
+		{
+			return cur;
+		}
+
+		// takes the next unit step and returns its direction index, NoDirection once the end is reached
+		inline unsigned Step()
+		{
+			if (Done())
+			{
+				return NoDirection;
+			}
+
+			// the next crossing along the axis k is at t = (2 * taken + 1) / (2 * delta)
+			int step[3] = { 0, 0, 0 };
+			unsigned best = 3U;
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				if (taken[k] == delta[k])
+				{
+					continue;
+				}
+				if (best == 3U)
+				{
+					best = k;
+					step[k] = sign[k];
+					continue;
+				}
+				const uint64_t lhs = uint64_t(2U * taken[k] + 1U) * delta[best];
+				const uint64_t rhs = uint64_t(2U * taken[best] + 1U) * delta[k];
+				if (lhs < rhs)
+				{
+					step[0] = step[1] = step[2] = 0;
+					best = k;
+					step[k] = sign[k];
+				}
+				else if (lhs == rhs)
+				{
+					step[k] = sign[k];
+				}
+			}
+
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				taken[k] += step[k] != 0 ? 1U : 0U;
+			}
+			cur.x += step[0];
+			cur.y += step[1];
+			cur.z += step[2];
+			return DirectionIndex(step[0], step[1], step[2]);
+		}
+
+	private:
+
+		FPosition cur, last;
+		unsigned delta[3];
+		int sign[3];
+		unsigned taken[3];
+
+	};
+
+	/*
+		Whether an agent can go straight from a to b: every unit step of the DDA walk has to be a move
+		CanMove allows, so the corner rules of dMove apply where the segment crosses an edge or a corner;
+		voxels, if given, is increased by the number of voxels visited
+	*/
+	template <class TGrid>
+	inline bool LineOfSight(const TGrid & g, const FPosition & a, const FPosition & b, DiagonalMovement dMove = DiagonalMovement::Always, unsigned long long * voxels = NULL)
+	{
+		if (!g(a))
+		{
+			return false;
+		}
+		VoxelLine line(a, b);
+		while (!line.Done())
+		{
+			const FPosition p = line.Current();
+			const unsigned d = line.Step();
+			if (voxels)
+			{
+				++*voxels;
+			}
+			if (!CanMove(g, p.x, p.y, p.z, d, dMove))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
+
+#endif // !LINE_OF_SIGHT_H
\ No newline at end of file
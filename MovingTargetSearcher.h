@@ -0,0 +1,286 @@
+#ifndef MOVING_TARGET_SEARCHER_H
+#define MOVING_TARGET_SEARCHER_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Moving-target search in the style of Fringe-Retrieving A*: the A* tree of the previous call is kept,
+		a new finish only resumes the expansion, and a start that moved inside the tree
+		keeps the subtree below it and retrieves its fringe; with the consistent DirectionDistance heuristic
+		the closed voxels stay optimal, so a tick expands about as much as the goal moved;
+		like the km of D* Lite, the open keys are lower bounds that are only refreshed when they surface
+	*/
+	class MovingTargetSearcher
+	{
+
+	public:
+
+		MovingTargetSearcher(const FGrid & g, DiagonalMovement d = DiagonalMovement::Always) : grid(g), dMove(d) {}
+
+		/*
+			Returns: 1) empty vector - the path does not exist
+					 2) vector with the only element - the start and the finish match
+					 3) vector with the start, the voxels where the direction changes and the finish
+		*/
+		std::vector<FPosition> FindPath(FPosition Start, FPosition Finish);
+
+		// the grid has been edited, the next FindPath starts a new tree
+		inline void Reset()
+		{
+			states.clear();
+			open.clear();
+			root = FPosition();
+		}
+
+		// cost of the last path in DirectionCost units, unsigned(-1) if there is none
+		inline unsigned GetCost() const
+		{
+			std::map<FPosition, FState>::const_iterator it = states.find(finish);
+			return it != states.end() && it->second.closed ? it->second.g : Infinity;
+		}
+
+		// voxels expanded by the last FindPath
+		inline unsigned GetExpansions() const
+		{
+			return expansions;
+		}
+
+		inline void FreeMemory()
+		{
+			std::map<FPosition, FState>().swap(states);
+			std::set<QueueItem>().swap(open);
+			root = FPosition();
+		}
+
+		static const unsigned Infinity = unsigned(-1);
+
+	private:
+
+		// (f + km, Infinity - g), the deeper voxel wins a tie
+		typedef std::pair<unsigned, unsigned> Key;
+		typedef std::pair<Key, FPosition> QueueItem;
+
+		struct FState
+		{
+			unsigned g = Infinity;
+			// the key the voxel is queued with, valid while it is open
+			Key key;
+			// direction of the step back to the parent
+			uint8_t parent = NoDirection;
+			bool closed = false;
+		};
+
+		const FGrid & grid;
+		DiagonalMovement dMove;
+		FPosition root, finish;
+		// the sum of the finish moves since the open keys were last exact
+		unsigned km = 0U;
+		unsigned expansions = 0U;
+		std::map<FPosition, FState> states;
+		std::set<QueueItem> open;
+
+		inline Key key(const FPosition & p, unsigned g) const
+		{
+			return Key(g + DirectionDistance(p, finish) + km, Infinity - g);
+		}
+
+		void restart();
+		void reroot(const FPosition & Start);
+		void relax(const FPosition & p, uint8_t parent, unsigned g);
+		std::vector<FPosition> backtrace() const;
+
+	};
+
+	inline std::vector<FPosition> MovingTargetSearcher::FindPath(FPosition Start, FPosition Finish)
+	{
+		expansions = 0U;
+		std::vector<FPosition> path;
+		if (!grid(Start) || !grid(Finish))
+		{
+			// 1) the path does not exist
+			return path;
+		}
+		if (Start == Finish)
+		{
+			// 2) the start and the finish match
+			path.push_back(Start);
+			return path;
+		}
+
+		std::map<FPosition, FState>::const_iterator s = states.find(Start);
+		if (s == states.end() || !s->second.closed)
+		{
+			finish = Finish;
+			root = Start;
+			restart();
+		}
+		else
+		{
+			if (Start != root)
+			{
+				reroot(Start);
+			}
+			// the heuristic of an open voxel drops by at most the distance the finish moved
+			km += DirectionDistance(finish, Finish);
+			finish = Finish;
+		}
+
+		std::map<FPosition, FState>::iterator f = states.find(finish);
+		while ((f == states.end() || !f->second.closed) && !open.empty())
+		{
+			const QueueItem top = *open.begin();
+			const FPosition p = top.second;
+			open.erase(open.begin());
+			FState & sp = states[p];
+			const Key fresh = key(p, sp.g);
+			if (top.first < fresh)
+			{
+				sp.key = fresh;
+				open.insert(QueueItem(fresh, p));
+				continue;
+			}
+			sp.closed = true;
+			++expansions;
+
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				if (CanMove(grid, p.x, p.y, p.z, d, dMove))
+				{
+					relax(FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]), uint8_t(OppositeDirection(d)), sp.g + DirectionCost(d));
+				}
+			}
+			if (p == finish)
+			{
+				f = states.find(finish);
+			}
+		}
+
+		if (f == states.end() || !f->second.closed)
+		{
+			// 1) the path does not exist, the whole component is closed now and stays reusable
+			return path;
+		}
+		// 3) the path
+		return backtrace();
+	}
+
+	inline void MovingTargetSearcher::restart()
+	{
+		states.clear();
+		open.clear();
+		km = 0U;
+		FState & s = states[root];
+		s.g = 0U;
+		s.key = key(root, 0U);
+		open.insert(QueueItem(s.key, root));
+	}
+
+	/*
+		Keeps the closed subtree under the new start, whose costs from it are the old ones minus its own,
+		and rebuilds the open list from every voxel next to that subtree
+	*/
+	inline void MovingTargetSearcher::reroot(const FPosition & Start)
+	{
+		const unsigned base = states[Start].g;
+		std::vector<std::pair<FPosition, FState>> kept(1, std::make_pair(Start, FState()));
+		kept[0].second.g = 0U;
+		kept[0].second.closed = true;
+		for (unsigned i = 0; i < kept.size(); ++i)
+		{
+			const FPosition p = kept[i].first;
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				const FPosition n(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+				std::map<FPosition, FState>::const_iterator it = states.find(n);
+				// a closed child points back along the opposite move
+				if (it != states.end() && it->second.closed && it->second.parent == OppositeDirection(d) && n != Start)
+				{
+					kept.push_back(*it);
+					kept.back().second.g -= base;
+				}
+			}
+		}
+		struct ByPosition
+		{
+			bool operator()(const std::pair<FPosition, FState> & a, const std::pair<FPosition, FState> & b) const
+			{
+				return a.first < b.first;
+			}
+		};
+		// sorted, so the map below is filled in linear time
+		std::sort(kept.begin(), kept.end(), ByPosition());
+
+		states.clear();
+		for (unsigned i = 0; i < kept.size(); ++i)
+		{
+			states.insert(states.end(), kept[i]);
+		}
+		open.clear();
+		km = 0U;
+		root = Start;
+
+		// the fringe: the best way into every voxel next to the kept subtree
+		for (unsigned i = 0; i < kept.size(); ++i)
+		{
+			const FPosition & p = kept[i].first;
+			for (unsigned d = 0; d < DirectionCount; ++d)
+			{
+				if (CanMove(grid, p.x, p.y, p.z, d, dMove))
+				{
+					relax(FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]), uint8_t(OppositeDirection(d)), kept[i].second.g + DirectionCost(d));
+				}
+			}
+		}
+	}
+
+	inline void MovingTargetSearcher::relax(const FPosition & p, uint8_t parent, unsigned g)
+	{
+		FState & s = states[p];
+		if (s.closed || g >= s.g)
+		{
+			return;
+		}
+		if (s.g != Infinity)
+		{
+			open.erase(QueueItem(s.key, p));
+		}
+		s.g = g;
+		s.parent = parent;
+		s.key = key(p, g);
+		open.insert(QueueItem(s.key, p));
+	}
+
+	inline std::vector<FPosition> MovingTargetSearcher::backtrace() const
+	{
+		std::vector<FPosition> path(1, finish);
+		FPosition p = finish;
+		uint8_t prev = NoDirection;
+		while (p != root)
+		{
+			const uint8_t d = states.find(p)->second.parent;
+			// only the voxels where the direction changes are kept
+			if (d != prev && prev != NoDirection)
+			{
+				path.push_back(p);
+			}
+			prev = d;
+			p = FPosition(p.x + DirX[d], p.y + DirY[d], p.z + DirZ[d]);
+		}
+		path.push_back(root);
+		return std::vector<FPosition>(path.rbegin(), path.rend());
+	}
+
+}
+
+#endif // !MOVING_TARGET_SEARCHER_H
\ No newline at end of file
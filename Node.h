@@ -10,11 +10,13 @@ namespace JPS {
 
 	public:
 
-		Node(const FPosition & p) : F(0U), G(0U), pos(p), parent(NULL), flag(0) {}
+		Node(const FPosition & p) : F(0U), G(0U), pos(p), parent(NULL), anyParent(NULL), flag(0) {}
 
 		unsigned F, G;
 		const FPosition pos;
 		const Node * parent;
+		// any-angle mode: the ancestor the node is reached from in a straight line, parent keeps the jump direction
+		const Node * anyParent;
 
 #pragma region Open/Closed_methods
 
@@ -38,6 +40,33 @@ namespace JPS {
 			return !!(flag & uint8_t(2));
 		}
 
+		// ARA*: closed node whose G has improved since it was expanded
+		inline void SetIncons()
+		{
+			flag |= uint8_t(4);
+		}
+
+		inline bool IsIncons() const
+		{
+			return !!(flag & uint8_t(4));
+		}
+
+		// ARA*: node keeps its G but is neither closed nor in the open list
+		inline void SetStale()
+		{
+			flag = uint8_t(1) | uint8_t(8);
+		}
+
+		inline bool IsStale() const
+		{
+			return !!(flag & uint8_t(8));
+		}
+
+		inline void Reopen()
+		{
+			flag = uint8_t(1);
+		}
+
 #pragma endregion
 
 		inline void ResetState()
@@ -45,6 +74,7 @@ namespace JPS {
 			F = 0U;
 			G = 0U;
 			parent = NULL;
+			anyParent = NULL;
 			flag = uint8_t(0);
 		}
 
@@ -41,6 +41,11 @@ namespace JPS {
 			std::make_heap(nodes.begin(), nodes.end(), cmp);
 		}
 
+		inline const Node * top() const
+		{
+			return nodes.empty() ? NULL : nodes.front();
+		}
+
 #pragma endregion
 
 		inline bool Empty() const
@@ -48,6 +53,16 @@ namespace JPS {
 			return nodes.empty();
 		}
 
+		inline size_t Size() const
+		{
+			return nodes.size();
+		}
+
+		inline void Swap(Openlist & other)
+		{
+			nodes.swap(other.nodes);
+		}
+
 		inline void Clear()
 		{
 			nodes.clear();
@@ -0,0 +1,488 @@
+#ifndef PARALLEL_SEARCHER_H
+#define PARALLEL_SEARCHER_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+#include "Searcher.h"
+
+namespace JPS {
+
+	/*
+		Hash Distributed A* (HDA*) over the jump points for a single very large query: every jump point belongs to
+		the worker its Zobrist hash picks, which keeps its node and its open entry; a successor owned by another worker
+		is sent to it through a lock-free queue. The first path found is only an incumbent, the search ends once
+		no open node nor message in flight can beat it, so the path is as short as a serial A* would find.
+		The costs are the ones of DirectionCost, a jump of n voxels costing n steps, and the heuristic is DirectionDistance,
+		consistent for them, so the paths are optimal whatever the number of workers, where FindPath with its Manhattan heuristic is greedier.
+		The messages come from pools of the workers and go back to the pool of the one that takes them, so a query
+		allocates only while the pools grow
+	*/
+	class ParallelSearcher
+	{
+
+	public:
+
+		// every worker copies the settings and the grid of Prototype; threads == 0 uses every hardware thread, the calling one included
+		ParallelSearcher(const Searcher & Prototype, unsigned threads = 0U);
+
+		/*
+			Returns: 1) empty vector - the path does not exist
+					 2) vector with the only element - the start and the finish match
+					 3) vector with the start, the jump points and the finish, as FindPath returns them
+		*/
+		std::vector<FPosition> FindPath(FPosition Start, FPosition Finish);
+
+		// hands new settings to every worker, between the queries; the grid may change, its size may not
+		inline void SetPrototype(const Searcher & Prototype)
+		{
+			assert(Prototype.GetGrid().x == grid.x && Prototype.GetGrid().y == grid.y && Prototype.GetGrid().z == grid.z);
+			for (unsigned w = 0; w < workers.size(); ++w)
+			{
+				workers[w]->searcher = Prototype;
+			}
+		}
+
+		inline unsigned GetThreads() const
+		{
+			return unsigned(workers.size());
+		}
+
+		/*
+			How far behind the best open node of all, in DirectionCost units, a worker may expand before it waits for the others:
+			the f its node is above that one plus the depth it lacks at the same f. 0 keeps the serial order, no wasted
+			expansion but little parallel work; Infinity never waits, and the workers then sweep the whole plateau of equal f
+		*/
+		inline void SetSlack(unsigned s)
+		{
+			slack = s;
+		}
+
+		inline unsigned GetSlack() const
+		{
+			return slack;
+		}
+
+		// expansions of the last query, of all the workers
+		unsigned GetExpansions() const;
+
+		// the cost of the last path found in DirectionCost units, Infinity if there was none
+		inline unsigned GetCost() const
+		{
+			return best;
+		}
+
+		static const unsigned Infinity = unsigned(-1);
+		static const unsigned DefaultSlack = 20U;
+
+	private:
+
+		static const uint64_t NoKey = uint64_t(-1);
+
+		struct FEntry
+		{
+			unsigned g;
+			FPosition parent;
+		};
+
+		struct FMessage
+		{
+			FPosition pos, parent;
+			unsigned g;
+			FMessage * next;
+		};
+
+		// (f, g, voxel), the deeper node first among equal f
+		typedef std::pair<std::pair<unsigned, unsigned>, uint64_t> QueueItem;
+
+		struct FWorker
+		{
+			FWorker(const Searcher & s) : searcher(s), inbox(NULL), localMin(NoKey), sent(0U), received(0U), expansions(0U), pool(NULL) {}
+
+			Searcher searcher;
+			std::unordered_map<uint64_t, FEntry> nodes;
+			std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+			// messages from the other workers, a stack many push to and the owner takes whole
+			std::atomic<FMessage *> inbox;
+			// the order of the best open node that can still beat the incumbent, NoKey if none can
+			std::atomic<uint64_t> localMin;
+			std::atomic<uint64_t> sent, received;
+			unsigned expansions;
+			// messages free to send, only the worker touches them; the blocks they were carved from
+			FMessage * pool;
+			std::vector<std::unique_ptr<FMessage[]>> blocks;
+		};
+
+		static const unsigned BlockSize = 1024U;
+
+		const FGrid & grid;
+		std::vector<std::unique_ptr<FWorker>> workers;
+		std::vector<uint64_t> zobrist;
+		FPosition finish;
+		std::atomic<unsigned> best;
+		std::atomic<bool> done;
+		unsigned slack = DefaultSlack;
+
+		inline uint64_t key(const FPosition & p) const
+		{
+			return (uint64_t(p.z) * grid.y + p.y) * grid.x + p.x;
+		}
+
+		inline FPosition position(uint64_t k) const
+		{
+			return FPosition(unsigned(k % grid.x), unsigned(k / grid.x % grid.y), unsigned(k / (uint64_t(grid.x) * grid.y)));
+		}
+
+		// the owner of a voxel, random keys of x, y and z xor-ed so neighbouring jump points spread over the workers
+		inline unsigned owner(const FPosition & p) const
+		{
+			const uint64_t h = zobrist[p.x] ^ zobrist[grid.x + p.y] ^ zobrist[grid.x + grid.y + p.z];
+			return unsigned((h >> 17) % workers.size());
+		}
+
+		// f, then the deeper node first, as one number
+		static inline uint64_t order(const QueueItem & q)
+		{
+			return (uint64_t(q.first.first) << 32) | q.first.second;
+		}
+
+		// how far the node of order k is behind the one of order m: the f above it, plus the depth it lacks at that f
+		static inline uint64_t lag(uint64_t k, uint64_t m)
+		{
+			if (k <= m)
+			{
+				return 0U;
+			}
+			const uint64_t gk = Infinity - (k & 0xFFFFFFFFU), gm = Infinity - (m & 0xFFFFFFFFU);
+			return ((k >> 32) - (m >> 32)) + (gm > gk ? gm - gk : 0U);
+		}
+
+		// the lowest localMin of all the workers
+		inline uint64_t globalMin() const
+		{
+			uint64_t m = NoKey;
+			for (unsigned w = 0; w < workers.size(); ++w)
+			{
+				m = std::min(m, workers[w]->localMin.load(std::memory_order_relaxed));
+			}
+			return m;
+		}
+
+		void work(unsigned w);
+		void relax(FWorker & wk, const FPosition & p, const FPosition & parent, unsigned g);
+		bool finished() const;
+		FMessage * allocate(FWorker & wk);
+		void rebalance();
+
+	};
+
+	inline ParallelSearcher::ParallelSearcher(const Searcher & Prototype, unsigned threads) : grid(Prototype.GetGrid()), best(Infinity), done(false)
+	{
+		if (!threads)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+		}
+		for (unsigned w = 0; w < threads; ++w)
+		{
+			workers.push_back(std::unique_ptr<FWorker>(new FWorker(Prototype)));
+		}
+		std::mt19937_64 random(0x9E3779B97F4A7C15ULL);
+		zobrist.resize(size_t(grid.x) + grid.y + grid.z);
+		for (size_t i = 0; i < zobrist.size(); ++i)
+		{
+			zobrist[i] = random();
+		}
+	}
+
+	inline unsigned ParallelSearcher::GetExpansions() const
+	{
+		unsigned n = 0U;
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			n += workers[w]->expansions;
+		}
+		return n;
+	}
+
+	inline std::vector<FPosition> ParallelSearcher::FindPath(FPosition Start, FPosition Finish)
+	{
+		std::vector<FPosition> path;
+		Searcher & first = workers[0]->searcher;
+		Start.Normalize(first.GetSkip());
+		Finish.Normalize(first.GetSkip());
+		best = Infinity;
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			FWorker & wk = *workers[w];
+			wk.nodes.clear();
+			wk.open = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>();
+			wk.localMin = NoKey;
+			wk.sent = 0U;
+			wk.received = 0U;
+			wk.expansions = 0U;
+		}
+		rebalance();
+		if (!first.IsPassable(Start) || !first.IsPassable(Finish) || !first.MayReach(Start, Finish))
+		{
+			// 1) the path does not exist
+			return path;
+		}
+		if (Start == Finish)
+		{
+			// 2) the start and the finish match
+			best = 0U;
+			path.push_back(Start);
+			return path;
+		}
+
+		finish = Finish;
+		done = false;
+		FWorker & root = *workers[owner(Start)];
+		relax(root, Start, InvalidPos, 0U);
+		root.localMin = order(root.open.top());
+
+		std::vector<std::thread> threads;
+		for (unsigned w = 1; w < workers.size(); ++w)
+		{
+			threads.push_back(std::thread([this, w]() { work(w); }));
+		}
+		work(0U);
+		for (unsigned t = 0; t < threads.size(); ++t)
+		{
+			threads[t].join();
+		}
+
+		if (best == Infinity)
+		{
+			// 1) the path does not exist
+			return path;
+		}
+		// 3) the parents are spread over the workers, which have all stopped
+		for (FPosition p = Finish; p.IsValid(); p = workers[owner(p)]->nodes[key(p)].parent)
+		{
+			path.push_back(p);
+		}
+		std::reverse(path.begin(), path.end());
+		return path;
+	}
+
+	inline void ParallelSearcher::relax(FWorker & wk, const FPosition & p, const FPosition & parent, unsigned g)
+	{
+		const std::pair<std::unordered_map<uint64_t, FEntry>::iterator, bool> it = wk.nodes.insert(std::make_pair(key(p), FEntry()));
+		FEntry & e = it.first->second;
+		if (!it.second && e.g <= g)
+		{
+			return;
+		}
+		e.g = g;
+		e.parent = parent;
+		// a node reached again at a lower cost is opened again, its old entry is skipped when popped
+		wk.open.push(QueueItem(std::make_pair(g + DirectionDistance(p, finish), Infinity - g), key(p)));
+	}
+
+	inline void ParallelSearcher::work(unsigned w)
+	{
+		FWorker & wk = *workers[w];
+		FPosition buf[26];
+		while (!done.load())
+		{
+			// the messages are in the open list before they count as received, see finished()
+			FMessage * m = wk.inbox.exchange(NULL);
+			uint64_t count = 0U;
+			while (m)
+			{
+				FMessage * next = m->next;
+				relax(wk, m->pos, m->parent, m->g);
+				m->next = wk.pool;
+				wk.pool = m;
+				m = next;
+				++count;
+			}
+
+			// nodes that cannot beat the incumbent are dropped, they never can again
+			const unsigned incumbent = best.load();
+			while (!wk.open.empty() && wk.open.top().first.first >= incumbent)
+			{
+				wk.open.pop();
+			}
+			wk.localMin = wk.open.empty() ? NoKey : order(wk.open.top());
+			if (count)
+			{
+				wk.received += count;
+			}
+
+			if (wk.open.empty())
+			{
+				if (finished())
+				{
+					done = true;
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+				continue;
+			}
+
+			/*
+				A worker more than the slack behind the best node of all waits for the others: the nodes within the slack
+				are expanded in parallel, the ones far behind would mostly be wasted once the path is found
+			*/
+			if (slack != Infinity && lag(wk.localMin.load(std::memory_order_relaxed), globalMin()) > slack)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			const QueueItem top = wk.open.top();
+			wk.open.pop();
+			const unsigned g = Infinity - top.first.second;
+			const FEntry & e = wk.nodes[top.second];
+			if (e.g != g)
+			{
+				// stale, the node was reached again at a lower cost
+				continue;
+			}
+			const FPosition p = position(top.second);
+			++wk.expansions;
+			if (p == finish)
+			{
+				unsigned b = best.load();
+				while (g < b && !best.compare_exchange_weak(b, g))
+				{
+				}
+				continue;
+			}
+
+			const FPosition parent = e.parent;
+			const unsigned cnt = wk.searcher.Successors(p, parent, finish, &buf[0]);
+			for (unsigned i = 0; i < cnt; ++i)
+			{
+				// a jump is a straight line along one of the 26 directions, so this is its exact cost
+				const unsigned ng = g + DirectionDistance(buf[i], p);
+				if (ng + DirectionDistance(buf[i], finish) >= best.load())
+				{
+					continue;
+				}
+				const unsigned o = owner(buf[i]);
+				if (o == w)
+				{
+					relax(wk, buf[i], p, ng);
+					continue;
+				}
+				// counted as sent before it can be received, see finished()
+				FMessage * msg = allocate(wk);
+				msg->pos = buf[i];
+				msg->parent = p;
+				msg->g = ng;
+				++wk.sent;
+				std::atomic<FMessage *> & inbox = workers[o]->inbox;
+				msg->next = inbox.load(std::memory_order_relaxed);
+				while (!inbox.compare_exchange_weak(msg->next, msg, std::memory_order_release, std::memory_order_relaxed))
+				{
+				}
+				// the node counts for the order of the owner before it is taken, the others wait for it as for an open one
+				const uint64_t k = order(QueueItem(std::make_pair(ng + DirectionDistance(buf[i], finish), Infinity - ng), 0U));
+				std::atomic<uint64_t> & lm = workers[o]->localMin;
+				uint64_t cur = lm.load();
+				while (k < cur && !lm.compare_exchange_weak(cur, k))
+				{
+				}
+			}
+		}
+
+	}
+
+	inline ParallelSearcher::FMessage * ParallelSearcher::allocate(FWorker & wk)
+	{
+		if (!wk.pool)
+		{
+			FMessage * block = new FMessage[BlockSize];
+			wk.blocks.push_back(std::unique_ptr<FMessage[]>(block));
+			for (unsigned i = 0; i < BlockSize; ++i)
+			{
+				block[i].next = wk.pool;
+				wk.pool = &block[i];
+			}
+		}
+		FMessage * m = wk.pool;
+		wk.pool = m->next;
+		return m;
+	}
+
+	/*
+		Between the queries: the messages left in the inboxes go back to the pools, and the pools are dealt out evenly,
+		since the messages gather at the workers that receive more than they send
+	*/
+	inline void ParallelSearcher::rebalance()
+	{
+		FMessage * all = NULL;
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			FWorker & wk = *workers[w];
+			FMessage * lists[2] = { wk.inbox.exchange(NULL), wk.pool };
+			wk.pool = NULL;
+			for (unsigned l = 0; l < 2; ++l)
+			{
+				while (lists[l])
+				{
+					FMessage * next = lists[l]->next;
+					lists[l]->next = all;
+					all = lists[l];
+					lists[l] = next;
+				}
+			}
+		}
+		for (unsigned w = 0; all; w = (w + 1U) % unsigned(workers.size()))
+		{
+			FMessage * next = all->next;
+			all->next = workers[w]->pool;
+			workers[w]->pool = all;
+			all = next;
+		}
+	}
+
+	/*
+		Whether no node anywhere can beat the incumbent: the received counts are summed first and the sent ones last,
+		so equal sums mean no message was in flight or sent in between; a receiver lowers its localMin before
+		it counts a message, and a sender only reports NoKey after it has counted what it sent, so every node
+		that could still beat the incumbent shows in some localMin
+	*/
+	inline bool ParallelSearcher::finished() const
+	{
+		uint64_t received = 0U;
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			received += workers[w]->received.load();
+		}
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			if (workers[w]->localMin.load() != NoKey)
+			{
+				return false;
+			}
+		}
+		uint64_t sent = 0U;
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			sent += workers[w]->sent.load();
+		}
+		return received == sent;
+	}
+
+}
+
+#endif // !PARALLEL_SEARCHER_H
\ No newline at end of file
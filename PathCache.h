@@ -0,0 +1,276 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <list>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+#include "Searcher.h"
+#include "LineOfSight.h"
+
+namespace JPS {
+
+	struct FPathCacheStats
+	{
+		unsigned long long hits = 0ULL;
+		unsigned long long misses = 0ULL;
+		unsigned long long invalidations = 0ULL;
+		unsigned long long evictions = 0ULL;
+	};
+
+	/*
+		LRU cache of found paths in front of Searcher::FindPath, keyed by the settings of the Searcher
+		and the (start, finish) pair quantized to Quantum voxels, and bounded by MaxBytes;
+		every path remembers the bricks it passes through, so an edit only drops the paths that pass within reach of it;
+		with Quantum > 1 a hit joins the real start and finish to the path cached for the same cell pair
+		with two short searches, valid but not always the shortest; a join that fails counts as a miss
+	*/
+	class PathCache
+	{
+
+	public:
+
+		PathCache(const FGrid & g, Searcher & s, size_t MaxBytes = size_t(64) << 20, unsigned Quantum = 1U) :
+			grid(g), searcher(s), maxBytes(MaxBytes), quantum(std::max(Quantum, 1U)) {}
+
+		// same values as Searcher::FindPath under its current settings, unreachable finishes are not cached
+		std::vector<FPosition> FindPath(FPosition Start, FPosition Finish);
+
+		// drops every path running through the bricks an agent of a cached radius at Changed would touch
+		void Invalidate(const std::vector<FPosition> & Changed);
+
+		inline void Clear()
+		{
+			entries.clear();
+			lookup.clear();
+			byBrick.clear();
+			radii.clear();
+			bytes = 0U;
+		}
+
+		inline const FPathCacheStats & GetStats() const
+		{
+			return stats;
+		}
+
+		inline size_t Size() const
+		{
+			return entries.size();
+		}
+
+		inline size_t Bytes() const
+		{
+			return bytes;
+		}
+
+	private:
+
+		typedef std::pair<Searcher::FSettings, std::pair<FPosition, FPosition>> Key;
+
+		struct Entry
+		{
+			Key key;
+			std::vector<FPosition> path;
+			std::vector<unsigned> bricks;
+			// the agent radius the path was found for, 0 without a clearance
+			unsigned radius;
+			size_t bytes;
+		};
+
+		typedef std::list<Entry> EntryList;
+
+		const FGrid & grid;
+		Searcher & searcher;
+		size_t maxBytes;
+		unsigned quantum;
+		size_t bytes = 0U;
+		FPathCacheStats stats;
+		// most recently used first
+		EntryList entries;
+		std::map<Key, EntryList::iterator> lookup;
+		std::map<unsigned, std::set<Key>> byBrick;
+		// the radii of the entries, the largest one bounds how far an edit reaches
+		std::multiset<unsigned> radii;
+
+		void erase(EntryList::iterator it);
+		bool join(const FPosition & Start, const FPosition & Finish, const std::vector<FPosition> & cached, std::vector<FPosition> & path);
+		void collectBricks(const std::vector<FPosition> & path, std::vector<unsigned> & bricks) const;
+
+	};
+
+	inline std::vector<FPosition> PathCache::FindPath(FPosition Start, FPosition Finish)
+	{
+		Key key(searcher.GetSettings(), std::make_pair(Start, Finish));
+		key.second.first.Normalize(quantum);
+		key.second.second.Normalize(quantum);
+
+		std::vector<FPosition> path;
+		std::map<Key, EntryList::iterator>::iterator found = lookup.find(key);
+		if (found != lookup.end())
+		{
+			if (join(Start, Finish, found->second->path, path))
+			{
+				++stats.hits;
+				entries.splice(entries.begin(), entries, found->second);
+				return path;
+			}
+			// the path found now replaces the one that could not be joined
+			erase(found->second);
+		}
+
+		++stats.misses;
+		path = searcher.FindPath(Start, Finish);
+		if (path.empty())
+		{
+			return path;
+		}
+
+		Entry e;
+		e.key = key;
+		e.path = path;
+		e.radius = key.first.clearance ? key.first.radius : 0U;
+		collectBricks(path, e.bricks);
+		e.bytes = sizeof(Entry) + path.size() * sizeof(FPosition) + e.bricks.size() * (sizeof(unsigned) + sizeof(Key) + 32U);
+		if (e.bytes > maxBytes)
+		{
+			return path;
+		}
+
+		while (!entries.empty() && bytes + e.bytes > maxBytes)
+		{
+			++stats.evictions;
+			erase(--entries.end());
+		}
+
+		bytes += e.bytes;
+		entries.push_front(e);
+		lookup[key] = entries.begin();
+		radii.insert(e.radius);
+		for (unsigned i = 0; i < e.bricks.size(); ++i)
+		{
+			byBrick[e.bricks[i]].insert(key);
+		}
+		return path;
+	}
+
+	inline void PathCache::Invalidate(const std::vector<FPosition> & Changed)
+	{
+		if (entries.empty())
+		{
+			return;
+		}
+
+		// an agent of radius r stands on no voxel closer than r to an obstacle, and the corner rules of its diagonal
+		// moves look one voxel further
+		const unsigned reach = std::max(*radii.rbegin(), 1U) + 1U;
+		std::set<unsigned> bricks;
+		for (unsigned i = 0; i < Changed.size(); ++i)
+		{
+			const FPosition & c = Changed[i];
+			const unsigned x0 = (c.x > reach ? c.x - reach : 0U) >> FGrid::BrickShift;
+			const unsigned y0 = (c.y > reach ? c.y - reach : 0U) >> FGrid::BrickShift;
+			const unsigned z0 = (c.z > reach ? c.z - reach : 0U) >> FGrid::BrickShift;
+			const unsigned x1 = std::min(c.x + reach, grid.x - 1U) >> FGrid::BrickShift;
+			const unsigned y1 = std::min(c.y + reach, grid.y - 1U) >> FGrid::BrickShift;
+			const unsigned z1 = std::min(c.z + reach, grid.z - 1U) >> FGrid::BrickShift;
+			for (unsigned bz = z0; bz <= z1; ++bz)
+			{
+				for (unsigned by = y0; by <= y1; ++by)
+				{
+					for (unsigned bx = x0; bx <= x1; ++bx)
+					{
+						bricks.insert((bz * grid.BricksY() + by) * grid.BricksX() + bx);
+					}
+				}
+			}
+		}
+
+		for (std::set<unsigned>::const_iterator b = bricks.begin(); b != bricks.end(); ++b)
+		{
+			std::map<unsigned, std::set<Key>>::iterator keys = byBrick.find(*b);
+			while (keys != byBrick.end() && !keys->second.empty())
+			{
+				++stats.invalidations;
+				erase(lookup[*keys->second.begin()]);
+				keys = byBrick.find(*b);
+			}
+		}
+	}
+
+	inline void PathCache::erase(EntryList::iterator it)
+	{
+		for (unsigned i = 0; i < it->bricks.size(); ++i)
+		{
+			std::map<unsigned, std::set<Key>>::iterator keys = byBrick.find(it->bricks[i]);
+			keys->second.erase(it->key);
+			if (keys->second.empty())
+			{
+				byBrick.erase(keys);
+			}
+		}
+		radii.erase(radii.find(it->radius));
+		bytes -= it->bytes;
+		lookup.erase(it->key);
+		entries.erase(it);
+	}
+
+	// the cached path itself if its ends are the asked ones, else the path from Start to its first voxel, the path
+	// and the path from its last voxel to Finish; false if one of the two does not exist
+	inline bool PathCache::join(const FPosition & Start, const FPosition & Finish, const std::vector<FPosition> & cached,
+		std::vector<FPosition> & path)
+	{
+		if (cached.front() == Start && cached.back() == Finish)
+		{
+			path = cached;
+			return true;
+		}
+
+		path = cached.front() == Start ? std::vector<FPosition>(1, Start) : searcher.FindPath(Start, cached.front());
+		if (path.empty())
+		{
+			return false;
+		}
+		path.insert(path.end(), cached.begin() + 1, cached.end());
+		if (cached.back() != Finish)
+		{
+			const std::vector<FPosition> tail = searcher.FindPath(cached.back(), Finish);
+			if (tail.empty())
+			{
+				path.clear();
+				return false;
+			}
+			path.insert(path.end(), tail.begin() + 1, tail.end());
+		}
+		return true;
+	}
+
+	// the bricks of every voxel on the segments between the waypoints, any-angle ones included
+	inline void PathCache::collectBricks(const std::vector<FPosition> & path, std::vector<unsigned> & bricks) const
+	{
+		for (unsigned i = 0; i < path.size(); ++i)
+		{
+			bricks.push_back(grid.BrickIndex(path[i]));
+			if (i + 1 == path.size())
+			{
+				break;
+			}
+
+			VoxelLine line(path[i], path[i + 1]);
+			while (line.Step() != NoDirection)
+			{
+				bricks.push_back(grid.BrickIndex(line.Current()));
+			}
+		}
+		std::sort(bricks.begin(), bricks.end());
+		bricks.erase(std::unique(bricks.begin(), bricks.end()), bricks.end());
+	}
+
+}
+
+#endif // !PATH_CACHE_H
\ No newline at end of file
@@ -0,0 +1,196 @@
+#ifndef PATH_SMOOTHER_H
+#define PATH_SMOOTHER_H
+
+#include <cmath>
+#include <vector>
+
+#include "LineOfSight.h"
+#include "Directions.h"
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	struct FPathSmootherStats
+	{
+		unsigned long long losChecks = 0ULL;
+		unsigned long long losVoxels = 0ULL;
+	};
+
+	/*
+		Walks the voxels of a waypoint path one by one without storing them;
+		the segments may be the straight ones of FindPath or any-angle ones of a pulled path,
+		which has to outlive the walker
+	*/
+	class PathWalker
+	{
+
+	public:
+
+		PathWalker(const std::vector<FPosition> & p) : path(p), line(p.empty() ? FPosition() : p[0], p.empty() ? FPosition() : p[0]) {}
+
+		// the next voxel of the path, false once the finish has been returned
+		inline bool Next(FPosition & out)
+		{
+			if (next >= path.size())
+			{
+				return false;
+			}
+			if (next == 0U)
+			{
+				out = path[next++];
+				return true;
+			}
+			if (line.Done())
+			{
+				line = VoxelLine(path[next - 1], path[next]);
+			}
+			line.Step();
+			out = line.Current();
+			if (line.Done())
+			{
+				++next;
+			}
+			return true;
+		}
+
+	private:
+
+		const std::vector<FPosition> & path;
+		VoxelLine line;
+		unsigned next = 0U;
+
+	};
+
+	/*
+		Post-processing of found paths: dense expansion into single voxels and string pulling,
+		which drops every waypoint a line of sight can skip; the line-of-sight tests are counted in the stats,
+		so the cost of smoothing a path can be measured next to the cost of finding it
+	*/
+	class PathSmoother
+	{
+
+	public:
+
+		PathSmoother(const FGrid & g, DiagonalMovement d = DiagonalMovement::Always) : grid(g), dMove(d) {}
+
+		// every voxel of the path, each one a unit move from the previous one
+		std::vector<FPosition> Expand(const std::vector<FPosition> & Path) const;
+
+		// keeps a waypoint only where the line of sight from the previous kept one breaks, one test per voxel
+		std::vector<FPosition> PullGreedy(const std::vector<FPosition> & Path);
+
+		/*
+			The shortest any-angle path through the voxels of Path, found by dynamic programming over them;
+			a test is skipped when it cannot improve the best length, but the worst case is a quadratic number of tests
+			of up to a linear number of voxels each, cubic in the voxels
+		*/
+		std::vector<FPosition> PullOptimal(const std::vector<FPosition> & Path);
+
+		inline bool LineOfSight(const FPosition & a, const FPosition & b)
+		{
+			++stats.losChecks;
+			return JPS::LineOfSight(grid, a, b, dMove, &stats.losVoxels);
+		}
+
+		inline const FPathSmootherStats & GetStats() const
+		{
+			return stats;
+		}
+
+		inline void ResetStats()
+		{
+			stats = FPathSmootherStats();
+		}
+
+		static inline float Length(const FPosition & a, const FPosition & b)
+		{
+			const float dx = float(int(a.x - b.x));
+			const float dy = float(int(a.y - b.y));
+			const float dz = float(int(a.z - b.z));
+			return sqrtf(dx * dx + dy * dy + dz * dz);
+		}
+
+	private:
+
+		const FGrid & grid;
+		DiagonalMovement dMove;
+		FPathSmootherStats stats;
+
+	};
+
+	inline std::vector<FPosition> PathSmoother::Expand(const std::vector<FPosition> & Path) const
+	{
+		std::vector<FPosition> dense;
+		PathWalker walker(Path);
+		FPosition p;
+		while (walker.Next(p))
+		{
+			dense.push_back(p);
+		}
+		return dense;
+	}
+
+	inline std::vector<FPosition> PathSmoother::PullGreedy(const std::vector<FPosition> & Path)
+	{
+		if (Path.size() < 3)
+		{
+			return Path;
+		}
+
+		std::vector<FPosition> pulled(1, Path.front());
+		PathWalker walker(Path);
+		FPosition prev, p;
+		walker.Next(prev);
+		while (walker.Next(p))
+		{
+			// prev is one unit move behind p, so it always sees it
+			if (!LineOfSight(pulled.back(), p))
+			{
+				pulled.push_back(prev);
+			}
+			prev = p;
+		}
+		pulled.push_back(Path.back());
+		return pulled;
+	}
+
+	inline std::vector<FPosition> PathSmoother::PullOptimal(const std::vector<FPosition> & Path)
+	{
+		if (Path.size() < 3)
+		{
+			return Path;
+		}
+
+		const std::vector<FPosition> dense = Expand(Path);
+		const unsigned n = unsigned(dense.size());
+		std::vector<float> best(n, 0.0f);
+		std::vector<unsigned> from(n, 0U);
+		for (unsigned j = 1; j < n; ++j)
+		{
+			// the step along the path is always visible
+			from[j] = j - 1;
+			best[j] = best[j - 1] + Length(dense[j - 1], dense[j]);
+			for (unsigned i = 0; i + 1 < j; ++i)
+			{
+				const float through = best[i] + Length(dense[i], dense[j]);
+				if (through < best[j] && LineOfSight(dense[i], dense[j]))
+				{
+					best[j] = through;
+					from[j] = i;
+				}
+			}
+		}
+
+		std::vector<FPosition> pulled;
+		for (unsigned j = n - 1; j > 0; j = from[j])
+		{
+			pulled.push_back(dense[j]);
+		}
+		pulled.push_back(dense[0]);
+		return std::vector<FPosition>(pulled.rbegin(), pulled.rend());
+	}
+
+}
+
+#endif // !PATH_SMOOTHER_H
\ No newline at end of file
@@ -0,0 +1,308 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "Grid.h"
+#include "Position.h"
+#include "Searcher.h"
+#include "SearchMask.h"
+#include "Components.h"
+#include "PathSmoother.h"
+
+namespace JPS {
+
+	/*
+		Occupancy pyramid for coarse-to-fine queries: the level k is a grid of 2^k voxel cells,
+		and a cell is free only if every voxel below it is free (max-pooled occupancy), so unlike the skip
+		of the searcher a coarse path never walks through a thin wall; a query plans on the coarsest level
+		that connects the endpoints and refines the coarse path with short budgeted JPS searches
+		next to it, so the work grows with the path length and not with the volume
+	*/
+	class Pyramid
+	{
+
+	public:
+
+		Pyramid(const FGrid & g, Searcher & s, unsigned Levels = 3U) : grid(g), searcher(s), levels(std::max(Levels, 1U)) {}
+
+		void Build();
+
+		// keeps the levels valid after the cells at Changed have been edited in the grid
+		void Update(const std::vector<FPosition> & Changed);
+
+		/*
+			Returns: 1) empty vector - the path does not exist
+					 2) vector with the only element - the start and the finish match
+					 3) vector with the start, the waypoints and the finish, every two neighbours on a straight line
+		*/
+		std::vector<FPosition> FindPath(FPosition Start, FPosition Finish);
+
+		// level k in [1, LevelCount()], cells of 2^k voxels
+		inline const FGrid & Level(unsigned k) const
+		{
+			return *grids[k - 1];
+		}
+
+		inline unsigned LevelCount() const
+		{
+			return unsigned(grids.size());
+		}
+
+		// the level the last path was planned on, 0 if it fell back to the full-resolution search
+		inline unsigned GetLastLevel() const
+		{
+			return lastLevel;
+		}
+
+	private:
+
+		const FGrid & grid;
+		Searcher & searcher;
+		unsigned levels;
+		unsigned lastLevel = 0U;
+		std::vector<std::unique_ptr<FGrid>> grids;
+		std::vector<std::unique_ptr<Searcher>> searchers;
+		// a coarse query between two components fails at once instead of flooding its level
+		std::vector<std::unique_ptr<Components>> components;
+
+		inline const FGrid & below(unsigned k) const
+		{
+			return k == 1U ? grid : *grids[k - 2];
+		}
+
+		// whether every child of the cell (x, y, z) of the level k is free
+		inline bool pooled(unsigned k, unsigned x, unsigned y, unsigned z) const
+		{
+			const FGrid & b = below(k);
+			for (unsigned dz = 0; dz < 2; ++dz)
+			{
+				for (unsigned dy = 0; dy < 2; ++dy)
+				{
+					for (unsigned dx = 0; dx < 2; ++dx)
+					{
+						const unsigned cx = 2 * x + dx;
+						const unsigned cy = 2 * y + dy;
+						const unsigned cz = 2 * z + dz;
+						// children past the border of an odd-sized level do not exist
+						if (cx < b.x && cy < b.y && cz < b.z && !b(cx, cy, cz))
+						{
+							return false;
+						}
+					}
+				}
+			}
+			return true;
+		}
+
+		// the voxel in the middle of a cell of the level k, clamped to the grid
+		inline FPosition centre(unsigned k, const FPosition & c) const
+		{
+			const unsigned half = (1U << k) >> 1;
+			return FPosition(
+				std::min((c.x << k) + half, grid.x - 1),
+				std::min((c.y << k) + half, grid.y - 1),
+				std::min((c.z << k) + half, grid.z - 1));
+		}
+
+		FPosition anchor(unsigned k, const FPosition & p) const;
+		bool tryLevel(unsigned k, const FPosition & Start, const FPosition & Finish, std::vector<FPosition> & path);
+		bool refine(unsigned k, const FPosition & a, const FPosition & b, std::vector<FPosition> & path);
+
+	};
+
+	inline void Pyramid::Build()
+	{
+		grids.clear();
+		searchers.clear();
+		components.clear();
+		for (unsigned k = 1; k <= levels; ++k)
+		{
+			const FGrid & b = below(k);
+			const unsigned x = (b.x + 1) / 2;
+			const unsigned y = (b.y + 1) / 2;
+			const unsigned z = (b.z + 1) / 2;
+			if (b.x < 2 && b.y < 2 && b.z < 2)
+			{
+				break;
+			}
+
+			std::vector<int> cells(x * y * z);
+			for (unsigned zz = 0; zz < z; ++zz)
+			{
+				for (unsigned yy = 0; yy < y; ++yy)
+				{
+					for (unsigned xx = 0; xx < x; ++xx)
+					{
+						cells[(zz * y + yy) * x + xx] = pooled(k, xx, yy, zz) ? 1 : 0;
+					}
+				}
+			}
+			grids.push_back(std::unique_ptr<FGrid>(new FGrid(x, y, z, &cells[0])));
+			searchers.push_back(std::unique_ptr<Searcher>(new Searcher(*grids.back(), searcher.GetDiagonalMovement())));
+			components.push_back(std::unique_ptr<Components>(new Components(*grids.back(), searcher.GetDiagonalMovement())));
+			components.back()->Build();
+			searchers.back()->SetComponents(components.back().get());
+		}
+	}
+
+	inline void Pyramid::Update(const std::vector<FPosition> & Changed)
+	{
+		std::vector<std::vector<FPosition>> changed(grids.size());
+		for (unsigned i = 0; i < Changed.size(); ++i)
+		{
+			FPosition c = Changed[i];
+			for (unsigned k = 1; k <= grids.size(); ++k)
+			{
+				c = FPosition(c.x >> 1, c.y >> 1, c.z >> 1);
+				const bool free = pooled(k, c.x, c.y, c.z);
+				if (free == (*grids[k - 1])(c))
+				{
+					// the levels above see no change either
+					break;
+				}
+				grids[k - 1]->SetCell(c, free ? 1 : 0);
+				changed[k - 1].push_back(c);
+			}
+		}
+		for (unsigned k = 0; k < grids.size(); ++k)
+		{
+			components[k]->Update(changed[k]);
+			searchers[k]->FreeMemory();
+		}
+	}
+
+	inline std::vector<FPosition> Pyramid::FindPath(FPosition Start, FPosition Finish)
+	{
+		std::vector<FPosition> path;
+		if (!grid(Start) || !grid(Finish))
+		{
+			// 1) the path does not exist
+			return path;
+		}
+		if (Start == Finish)
+		{
+			// 2) the start and the finish match
+			path.push_back(Start);
+			return path;
+		}
+		if (grids.empty())
+		{
+			Build();
+		}
+
+		for (unsigned k = unsigned(grids.size()); k > 0; --k)
+		{
+			if (tryLevel(k, Start, Finish, path))
+			{
+				// 3) the refined coarse path
+				lastLevel = k;
+				return path;
+			}
+		}
+
+		// narrow gaps only exist at full resolution
+		lastLevel = 0U;
+		return searcher.FindPath(Start, Finish);
+	}
+
+	// the free cell of the level k holding p or, if that cell is not free, a free one next to it
+	inline FPosition Pyramid::anchor(unsigned k, const FPosition & p) const
+	{
+		const FGrid & level = *grids[k - 1];
+		const FPosition c(p.x >> k, p.y >> k, p.z >> k);
+		if (level(c))
+		{
+			return c;
+		}
+		for (unsigned d = 0; d < DirectionCount; ++d)
+		{
+			const FPosition n(c.x + DirX[d], c.y + DirY[d], c.z + DirZ[d]);
+			if (level(n))
+			{
+				return n;
+			}
+		}
+		return FPosition();
+	}
+
+	inline bool Pyramid::tryLevel(unsigned k, const FPosition & Start, const FPosition & Finish, std::vector<FPosition> & path)
+	{
+		const FPosition cs = anchor(k, Start);
+		const FPosition cf = anchor(k, Finish);
+		if (!cs.IsValid() || !cf.IsValid() || cs == cf)
+		{
+			// blocked around the endpoints, or too close for this level
+			return false;
+		}
+
+		const std::vector<FPosition> coarse = searchers[k - 1]->FindPath(cs, cf);
+		if (coarse.empty())
+		{
+			return false;
+		}
+
+		/*
+			The centres of the coarse jump points are joined by straight segments through free cells only,
+			so they are mostly kept; the line of sight is tested through the searcher, whose mask, clearance, classes
+			and overlay may still reject one, and JPS only fills in the ends and the rejected segments
+		*/
+		std::vector<FPosition> waypoints(1, Start);
+		for (unsigned i = 0; i < coarse.size(); ++i)
+		{
+			waypoints.push_back(centre(k, coarse[i]));
+		}
+		waypoints.push_back(Finish);
+		waypoints.erase(std::unique(waypoints.begin(), waypoints.end()), waypoints.end());
+
+		path.assign(1, Start);
+		for (unsigned i = 0; i + 1 < waypoints.size(); ++i)
+		{
+			const bool inner = i > 0 && i + 2 < waypoints.size();
+			if (inner && searcher.LineOfSight(waypoints[i], waypoints[i + 1]))
+			{
+				path.push_back(waypoints[i + 1]);
+			}
+			else if (!refine(k, waypoints[i], waypoints[i + 1], path))
+			{
+				path.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+		Appends the fine path from a to b, searched inside their bounding box grown by a cell, within the mask of the searcher,
+		and with a budget of the volume a few cells around them
+	*/
+	inline bool Pyramid::refine(unsigned k, const FPosition & a, const FPosition & b, std::vector<FPosition> & path)
+	{
+		const unsigned span = 4U << k;
+		const unsigned margin = 1U << k;
+		const FPosition lo(
+			std::max(std::min(a.x, b.x), margin) - margin,
+			std::max(std::min(a.y, b.y), margin) - margin,
+			std::max(std::min(a.z, b.z), margin) - margin);
+		const FPosition hi(
+			std::min(std::max(a.x, b.x) + margin, grid.x - 1),
+			std::min(std::max(a.y, b.y) + margin, grid.y - 1),
+			std::min(std::max(a.z, b.z) + margin, grid.z - 1));
+		const SearchMask box(lo, hi);
+		const FSearchLimits limits(span * span * span / 4U, unsigned(-1), std::chrono::microseconds::max());
+		std::vector<FPosition> piece;
+		const SearchStatus status = searcher.FindPath(a, b, box, limits, piece);
+		if (status != SearchStatus::Found || piece.empty())
+		{
+			return false;
+		}
+		path.insert(path.end(), piece.begin() + 1, piece.end());
+		return true;
+	}
+
+}
+
+#endif // !PYRAMID_H
\ No newline at end of file
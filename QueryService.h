@@ -0,0 +1,393 @@
+#ifndef QUERY_SERVICE_H
+#define QUERY_SERVICE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "ESearchStatus.h"
+#include "SearchLimits.h"
+#include "Position.h"
+#include "Searcher.h"
+
+namespace JPS {
+
+	// the queries of a more urgent class always start first, a class is served in the order of submission
+	enum class QueryPriority : uint8_t
+	{
+		Urgent,
+		Normal,
+		Background
+	};
+
+	static const unsigned QueryPriorityCount = 3U;
+
+	struct FQueryResult
+	{
+		SearchStatus status = SearchStatus::NoPath;
+		// what Searcher::FindPath with the limits of the query puts in Path
+		std::vector<FPosition> path;
+	};
+
+	// latencies from submission to result of the queries that were not cancelled, over the last SampleCount of a class
+	struct FLatencyStats
+	{
+		size_t count = 0U;
+		std::chrono::microseconds p50 = std::chrono::microseconds::zero();
+		std::chrono::microseconds p90 = std::chrono::microseconds::zero();
+		std::chrono::microseconds p99 = std::chrono::microseconds::zero();
+		std::chrono::microseconds max = std::chrono::microseconds::zero();
+	};
+
+	/*
+		Asynchronous path queries: a request is queued by priority and answered by a pool of workers,
+		each with its own copy of the prototype Searcher, through a future or a callback.
+		A cancelled query that has not started is answered at once, a running one stops before its next expansion
+		and frees its nodes, so cancelling never waits for a search and never keeps its memory.
+		The callback runs on the thread that answers the query: the worker for a query that started, but the thread
+		calling Handle::Cancel, the destructor or a Submit after the shutdown for one that had not, so a callback
+		must not take a lock its canceller may hold while cancelling
+	*/
+	class QueryService
+	{
+
+		struct FQuery;
+
+	public:
+
+		typedef std::function<void(const FQueryResult &)> Callback;
+
+		// a submitted query; copies refer to the same query
+		class Handle
+		{
+
+		public:
+
+			Handle() {}
+
+			// no effect on an answered query; the callback of a query that has not started runs here, before the return
+			inline void Cancel()
+			{
+				if (query)
+				{
+					query->cancel = true;
+					if (query->claim(FQuery::Queued, FQuery::Cancelled))
+					{
+						query->deliver(FQueryResult(), SearchStatus::Cancelled);
+					}
+				}
+			}
+
+			inline bool IsDone() const
+			{
+				return result.valid() && result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			}
+
+			// waits for the answer, Cancelled for a cancelled query
+			inline const FQueryResult & Get() const
+			{
+				return result.get();
+			}
+
+		private:
+
+			friend class QueryService;
+
+			std::shared_ptr<FQuery> query;
+			std::shared_future<FQueryResult> result;
+
+		};
+
+		// threads == 0 uses every hardware thread
+		QueryService(const Searcher & Prototype, unsigned threads = 0U);
+
+		// answers the queued queries as cancelled, running their callbacks on this thread, cancels the running ones and waits for them
+		~QueryService();
+
+		QueryService(const QueryService &) = delete;
+		QueryService & operator=(const QueryService &) = delete;
+
+		Handle Submit(FPosition Start, FPosition Finish, QueryPriority Priority = QueryPriority::Normal,
+			const FSearchLimits & Limits = FSearchLimits(), Callback OnDone = Callback());
+
+		inline Handle Submit(FPosition Start, FPosition Finish, QueryPriority Priority, Callback OnDone)
+		{
+			return Submit(Start, Finish, Priority, FSearchLimits(), std::move(OnDone));
+		}
+
+		FLatencyStats GetLatency(QueryPriority Priority) const;
+
+		// queries submitted and not yet started, of every class
+		size_t Pending() const;
+
+		inline unsigned GetThreads() const
+		{
+			return unsigned(workers.size());
+		}
+
+		static const size_t SampleCount = 4096U;
+
+	private:
+
+		struct FQuery
+		{
+			enum EState : uint8_t
+			{
+				Queued,
+				Running,
+				Done,
+				Cancelled
+			};
+
+			FPosition start, finish;
+			FSearchLimits limits;
+			QueryPriority priority = QueryPriority::Normal;
+			std::chrono::steady_clock::time_point submitted;
+			std::atomic<bool> cancel{ false };
+			std::atomic<uint8_t> state{ Queued };
+			std::promise<FQueryResult> promise;
+			Callback onDone;
+
+			// the one thread that moves the query out of from answers it
+			inline bool claim(EState from, EState to)
+			{
+				uint8_t expected = from;
+				return state.compare_exchange_strong(expected, uint8_t(to));
+			}
+
+			inline void deliver(FQueryResult result, SearchStatus status)
+			{
+				result.status = status;
+				if (onDone)
+				{
+					onDone(result);
+				}
+				promise.set_value(std::move(result));
+			}
+		};
+
+		struct FSamples
+		{
+			std::vector<std::chrono::microseconds> latency;
+			size_t next = 0U;
+		};
+
+		std::vector<std::unique_ptr<Searcher>> searchers;
+		std::vector<std::thread> workers;
+		mutable std::mutex lock;
+		std::condition_variable wake;
+		std::deque<std::shared_ptr<FQuery>> queues[QueryPriorityCount];
+		// the query every worker runs, so the destructor can cancel it
+		std::vector<std::shared_ptr<FQuery>> running;
+		FSamples samples[QueryPriorityCount];
+		bool stop = false;
+
+		void loop(unsigned w);
+		void record(QueryPriority Priority, std::chrono::microseconds Latency);
+
+	};
+
+	inline QueryService::QueryService(const Searcher & Prototype, unsigned threads)
+	{
+		if (!threads)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+		}
+		running.resize(threads);
+		for (unsigned w = 0; w < threads; ++w)
+		{
+			searchers.push_back(std::unique_ptr<Searcher>(new Searcher(Prototype)));
+		}
+		for (unsigned w = 0; w < threads; ++w)
+		{
+			workers.push_back(std::thread([this, w]() { loop(w); }));
+		}
+	}
+
+	inline QueryService::~QueryService()
+	{
+		std::vector<std::shared_ptr<FQuery>> queued;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
+			for (unsigned p = 0; p < QueryPriorityCount; ++p)
+			{
+				queued.insert(queued.end(), queues[p].begin(), queues[p].end());
+				queues[p].clear();
+			}
+			for (unsigned w = 0; w < running.size(); ++w)
+			{
+				if (running[w])
+				{
+					running[w]->cancel = true;
+				}
+			}
+		}
+		wake.notify_all();
+		for (unsigned i = 0; i < queued.size(); ++i)
+		{
+			if (queued[i]->claim(FQuery::Queued, FQuery::Cancelled))
+			{
+				queued[i]->deliver(FQueryResult(), SearchStatus::Cancelled);
+			}
+		}
+		for (unsigned w = 0; w < workers.size(); ++w)
+		{
+			workers[w].join();
+		}
+	}
+
+	inline QueryService::Handle QueryService::Submit(FPosition Start, FPosition Finish, QueryPriority Priority, const FSearchLimits & Limits, Callback OnDone)
+	{
+		std::shared_ptr<FQuery> q = std::make_shared<FQuery>();
+		q->start = Start;
+		q->finish = Finish;
+		q->limits = Limits;
+		q->limits.cancel = &q->cancel;
+		q->priority = Priority;
+		q->onDone = std::move(OnDone);
+		q->submitted = std::chrono::steady_clock::now();
+
+		Handle h;
+		h.query = q;
+		h.result = q->promise.get_future().share();
+		bool accepted;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			accepted = !stop;
+			if (accepted)
+			{
+				queues[unsigned(Priority)].push_back(q);
+			}
+		}
+		if (!accepted)
+		{
+			// the service is shutting down
+			q->state = FQuery::Cancelled;
+			q->deliver(FQueryResult(), SearchStatus::Cancelled);
+			return h;
+		}
+		wake.notify_one();
+		return h;
+	}
+
+	inline void QueryService::loop(unsigned w)
+	{
+		Searcher & searcher = *searchers[w];
+		for (;;)
+		{
+			std::shared_ptr<FQuery> q;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				wake.wait(guard, [this]()
+				{
+					bool work = stop;
+					for (unsigned p = 0; p < QueryPriorityCount; ++p)
+					{
+						work = work || !queues[p].empty();
+					}
+					return work;
+				});
+				if (stop)
+				{
+					return;
+				}
+				for (unsigned p = 0; p < QueryPriorityCount && !q; ++p)
+				{
+					if (!queues[p].empty())
+					{
+						q = queues[p].front();
+						queues[p].pop_front();
+					}
+				}
+				// a query cancelled while queued has been answered already
+				if (!q->claim(FQuery::Queued, FQuery::Running))
+				{
+					continue;
+				}
+				running[w] = q;
+			}
+
+			FQueryResult result;
+			const SearchStatus status = searcher.FindPath(q->start, q->finish, q->limits, result.path);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				running[w].reset();
+			}
+			q->state = status == SearchStatus::Cancelled ? FQuery::Cancelled : FQuery::Done;
+			if (status != SearchStatus::Cancelled)
+			{
+				record(q->priority, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - q->submitted));
+			}
+			q->deliver(std::move(result), status);
+		}
+	}
+
+	inline void QueryService::record(QueryPriority Priority, std::chrono::microseconds Latency)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		FSamples & s = samples[unsigned(Priority)];
+		if (s.latency.size() < SampleCount)
+		{
+			s.latency.push_back(Latency);
+		}
+		else
+		{
+			s.latency[s.next] = Latency;
+			s.next = (s.next + 1U) % SampleCount;
+		}
+	}
+
+	inline FLatencyStats QueryService::GetLatency(QueryPriority Priority) const
+	{
+		std::vector<std::chrono::microseconds> l;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			l = samples[unsigned(Priority)].latency;
+		}
+		FLatencyStats stats;
+		stats.count = l.size();
+		if (l.empty())
+		{
+			return stats;
+		}
+		std::sort(l.begin(), l.end());
+		const auto at = [&l](unsigned percent) -> std::chrono::microseconds
+		{
+			return l[std::min(l.size() - 1U, (l.size() * percent) / 100U)];
+		};
+		stats.p50 = at(50U);
+		stats.p90 = at(90U);
+		stats.p99 = at(99U);
+		stats.max = l.back();
+		return stats;
+	}
+
+	inline size_t QueryService::Pending() const
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		size_t n = 0U;
+		for (unsigned p = 0; p < QueryPriorityCount; ++p)
+		{
+			for (unsigned i = 0; i < queues[p].size(); ++i)
+			{
+				// the cancelled ones wait in the queues until a worker drops them
+				n += queues[p][i]->state == FQuery::Queued ? 1U : 0U;
+			}
+		}
+		return n;
+	}
+
+}
+
+#endif // !QUERY_SERVICE_H
\ No newline at end of file
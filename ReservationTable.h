@@ -0,0 +1,121 @@
+#ifndef RESERVATION_TABLE_H
+#define RESERVATION_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Space-time reservations of cooperative planning: a voxel at a time step belongs to at most one agent;
+		only the reserved pairs are stored, so the table grows with the agents and their windows, not with the grid
+	*/
+	class ReservationTable
+	{
+
+	public:
+
+		ReservationTable(const FGrid & g) : grid(g) {}
+
+		// the agent holding the voxel at the time step, NoAgent if it is free
+		inline unsigned Owner(const FPosition & p, unsigned t) const
+		{
+			const CellMap::const_iterator it = cells.find(key(p, t));
+			return it == cells.end() ? NoAgent : it->second;
+		}
+
+		inline bool IsFree(const FPosition & p, unsigned t, unsigned Agent) const
+		{
+			const unsigned o = Owner(p, t);
+			return o == NoAgent || o == Agent;
+		}
+
+		// whether Agent may step from a at t to b at t + 1, which also rules out swapping places with another agent
+		inline bool CanTraverse(const FPosition & a, const FPosition & b, unsigned t, unsigned Agent) const
+		{
+			if (!IsFree(b, t + 1U, Agent))
+			{
+				return false;
+			}
+			const unsigned other = Owner(b, t);
+			return other == NoAgent || other == Agent || Owner(a, t + 1U) != other;
+		}
+
+		// false if another agent holds the voxel at the time step already
+		inline bool Reserve(const FPosition & p, unsigned t, unsigned Agent)
+		{
+			const FKey k = key(p, t);
+			const CellMap::iterator it = cells.find(k);
+			if (it != cells.end())
+			{
+				return it->second == Agent;
+			}
+			cells.insert(std::make_pair(k, Agent));
+			byAgent[Agent].push_back(k);
+			return true;
+		}
+
+		// drops every reservation of the agent, before it plans again
+		inline void Release(unsigned Agent)
+		{
+			const std::unordered_map<unsigned, std::vector<FKey>>::iterator it = byAgent.find(Agent);
+			if (it == byAgent.end())
+			{
+				return;
+			}
+			for (unsigned i = 0; i < it->second.size(); ++i)
+			{
+				cells.erase(it->second[i]);
+			}
+			byAgent.erase(it);
+		}
+
+		inline void Clear()
+		{
+			cells.clear();
+			byAgent.clear();
+		}
+
+		inline size_t Size() const
+		{
+			return cells.size();
+		}
+
+		static const unsigned NoAgent = unsigned(-1);
+
+	private:
+
+		// (voxel index, time step); the index alone may take all 64 bits on a large grid
+		typedef std::pair<uint64_t, unsigned> FKey;
+
+		struct FKeyHash
+		{
+			inline size_t operator()(const FKey & k) const
+			{
+				return std::hash<uint64_t>()(k.first ^ (uint64_t(k.second) * 0x9E3779B97F4A7C15ULL));
+			}
+		};
+
+		typedef std::unordered_map<FKey, unsigned, FKeyHash> CellMap;
+
+		const FGrid & grid;
+		CellMap cells;
+		std::unordered_map<unsigned, std::vector<FKey>> byAgent;
+
+		inline FKey key(const FPosition & p, unsigned t) const
+		{
+			return FKey((uint64_t(p.z) * grid.y + p.y) * grid.x + p.x, t);
+		}
+
+	};
+
+}
+
+#endif // !RESERVATION_TABLE_H
\ No newline at end of file
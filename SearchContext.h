@@ -0,0 +1,96 @@
+#ifndef SEARCH_CONTEXT_H
+#define SEARCH_CONTEXT_H
+
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "ESearchStatus.h"
+#include "Position.h"
+#include "Node.h"
+#include "Openlist.h"
+
+namespace JPS {
+
+	/*
+		Everything one query writes: the open lists, the nodes and the state of the resumable, bidirectional and anytime searches.
+		The grid and the acceleration structures are only read, so every thread searching one world needs just its own context;
+		the nodes point at each other, so a copy of a context starts empty instead of sharing them
+	*/
+	struct FSearchContext
+	{
+		FSearchContext() {}
+
+		FSearchContext(const FSearchContext &) {}
+
+		inline FSearchContext & operator=(const FSearchContext &)
+		{
+			FreeMemory();
+			return *this;
+		}
+
+		inline void FreeMemory()
+		{
+			openlist.Clear();
+			openlistB.Clear();
+			std::map<FPosition, Node>().swap(gridmap);
+			std::map<FPosition, Node>().swap(gridmapB);
+			startNode = NULL;
+			finishNode = NULL;
+			startNodeB = NULL;
+			finishNodeB = NULL;
+			stepsTotal = 0U;
+			queryStatus = SearchStatus::NoPath;
+			std::vector<FPosition>().swap(resultPath);
+			closest = NULL;
+			closestH = 0U;
+			targets.clear();
+			std::unordered_set<uint64_t>().swap(closed);
+			std::unordered_set<uint64_t>().swap(closedB);
+			meet = FPosition();
+			meetCost = unsigned(-1);
+			expansions = 0U;
+			anytime = false;
+			bidirectional = false;
+			lazyTheta = false;
+		}
+
+		Openlist openlist;
+		std::map<FPosition, Node> gridmap;
+		Node * startNode = NULL;
+		Node * finishNode = NULL;
+		// inactive direction of the bidirectional search, swapped in by Searcher::swapDirection()
+		Openlist openlistB;
+		std::map<FPosition, Node> gridmapB;
+		Node * startNodeB = NULL;
+		Node * finishNodeB = NULL;
+		// voxels each direction of the bidirectional search has closed, the jumps of the other one stop at them
+		std::unordered_set<uint64_t> closed;
+		std::unordered_set<uint64_t> closedB;
+		// cheapest voxel both directions reached so far and the cost of the path through it
+		FPosition meet;
+		unsigned meetCost = unsigned(-1);
+		unsigned stepsTotal = 0U;
+		// nodes expanded by the last query
+		unsigned expansions = 0U;
+		// state of the resumable query
+		SearchStatus queryStatus = SearchStatus::NoPath;
+		std::vector<FPosition> resultPath;
+		const Node * closest = NULL;
+		unsigned closestH = 0U;
+		// unsettled targets of FindPathToMany, the jumps stop at them as they do at the finish
+		std::set<FPosition> targets;
+		// set while FindPathAnytime runs, so improved closed nodes are marked inconsistent
+		bool anytime = false;
+		// set while FindPathBidirectional runs; it counts in octile distances as the anytime mode does
+		bool bidirectional = false;
+		// set while a query runs in the any-angle mode; ARA* and the bidirectional search do not verify the parents
+		bool lazyTheta = false;
+	};
+
+}
+
+#endif // !SEARCH_CONTEXT_H
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef SEARCH_LIMITS_H
+#define SEARCH_LIMITS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace JPS {
+
+	/*
+		Per-query budget of a search; every limit is checked between two expansions,
+		so a single long jump may overshoot maxSteps and maxTime slightly
+	*/
+	struct FSearchLimits
+	{
+		unsigned maxExpansions;
+		unsigned maxSteps;
+		std::chrono::microseconds maxTime;
+		// cooperative cancellation, another thread sets the flag and the search stops before its next expansion; NULL never cancels
+		const std::atomic<bool> * cancel;
+
+		FSearchLimits() : maxExpansions(unsigned(-1)), maxSteps(unsigned(-1)), maxTime(std::chrono::microseconds::max()), cancel(NULL) {}
+
+		FSearchLimits(unsigned expansions, unsigned steps, std::chrono::microseconds time, const std::atomic<bool> * Cancel = NULL) :
+			maxExpansions(expansions), maxSteps(steps), maxTime(time), cancel(Cancel) {}
+
+		inline bool HasTimeLimit() const
+		{
+			return maxTime != std::chrono::microseconds::max();
+		}
+	};
+
+}
+
+#endif // !SEARCH_LIMITS_H
\ No newline at end of file
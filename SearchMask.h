@@ -0,0 +1,113 @@
+#ifndef SEARCH_MASK_H
+#define SEARCH_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "Position.h"
+
+namespace JPS {
+
+	/*
+		Region a query is restricted to: an inclusive box and, optionally, a bitmask over that box
+		(bit (z * sizeY + y) * sizeX + x of the box-relative voxel, 64 voxels per word, least significant bit first);
+		the bits are either external, owned by the caller and never written, or filled in through Include
+	*/
+	class SearchMask
+	{
+
+	public:
+
+		SearchMask(const FPosition & Min, const FPosition & Max, const uint64_t * Bits = NULL) :
+			min(Min), max(Max), sx(Max.x - Min.x + 1), sy(Max.y - Min.y + 1), external(Bits) {}
+
+		// words a bitmask over the box [Min, Max] needs
+		static inline size_t WordCount(const FPosition & Min, const FPosition & Max)
+		{
+			const size_t count = size_t(Max.x - Min.x + 1) * (Max.y - Min.y + 1) * (Max.z - Min.z + 1);
+			return (count + 63) / 64;
+		}
+
+		/*
+			Adds a voxel of the box to the region; on a plain box the first call starts an empty bitmask region,
+			on external bits it makes an own copy of them first
+		*/
+		inline void Include(const FPosition & p)
+		{
+			if (!inBox(p.x, p.y, p.z))
+			{
+				return;
+			}
+			if (owned.empty())
+			{
+				owned.assign(WordCount(min, max), 0ULL);
+				if (external)
+				{
+					std::copy(external, external + owned.size(), owned.begin());
+					external = NULL;
+				}
+			}
+			const size_t i = index(p.x, p.y, p.z);
+			owned[i >> 6] |= 1ULL << (i & 63);
+		}
+
+		inline bool Contains(unsigned x, unsigned y, unsigned z) const
+		{
+			if (!inBox(x, y, z))
+			{
+				return false;
+			}
+			const uint64_t * bits = GetBits();
+			if (!bits)
+			{
+				return true;
+			}
+			const size_t i = index(x, y, z);
+			return !!((bits[i >> 6] >> (i & 63)) & 1ULL);
+		}
+
+		inline bool Contains(const FPosition & p) const
+		{
+			return Contains(p.x, p.y, p.z);
+		}
+
+		// the bitmask over the box, NULL if every voxel of the box is in the region
+		inline const uint64_t * GetBits() const
+		{
+			return external ? external : (owned.empty() ? NULL : &owned[0]);
+		}
+
+		inline const FPosition & GetMin() const
+		{
+			return min;
+		}
+
+		inline const FPosition & GetMax() const
+		{
+			return max;
+		}
+
+	private:
+
+		FPosition min, max;
+		unsigned sx, sy;
+		const uint64_t * external;
+		std::vector<uint64_t> owned;
+
+		inline bool inBox(unsigned x, unsigned y, unsigned z) const
+		{
+			return x >= min.x && y >= min.y && z >= min.z && x <= max.x && y <= max.y && z <= max.z;
+		}
+
+		inline size_t index(unsigned x, unsigned y, unsigned z) const
+		{
+			return (size_t(z - min.z) * sy + (y - min.y)) * sx + (x - min.x);
+		}
+
+	};
+
+}
+
+#endif // !SEARCH_MASK_H
\ No newline at end of file
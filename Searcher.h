@@ -2,14 +2,29 @@
 #define SEARCHER_H
 
 #include <map>
+#include <set>
+#include <tuple>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <cstdint>
 
 #include "EDiagonalMovement.h"
+#include "ESearchStatus.h"
+#include "SearchLimits.h"
 #include "Position.h"
 #include "Node.h"
 #include "Grid.h"
+#include "GridView.h"
+#include "SearchContext.h"
+#include "SearchMask.h"
+#include "Clearance.h"
+#include "GridOverlay.h"
 #include "Openlist.h"
+#include "Components.h"
+#include "LineOfSight.h"
 
 namespace JPS {
 
@@ -39,6 +54,7 @@ inline unsigned Euclidean(const Node* a, const Node* b)
 
 #define GridMap std::map<FPosition, Node>
 #define PositionVector std::vector<FPosition>
+#define TargetSet std::set<FPosition>
 
 // uncommment to debug
 #define JPS_DEBUG
@@ -55,20 +71,22 @@ class Searcher
 
 public:
 
-	Searcher(FGrid& g) : grid(g) {}
+	/*
+		The grid and the structures set below are only read, so any number of Searchers can search one world at once;
+		a copy of a configured Searcher takes its settings with an empty context, the cheap way to get one per thread
+	*/
+	Searcher(const FGrid& g) : grid(g) {}
 
-	Searcher(FGrid& g, DiagonalMovement d) : grid(g), dMove(d) {}
+	Searcher(const FGrid& g, DiagonalMovement d) : grid(g), dMove(d) {}
 
 	void FreeMemory()
 	{
-		openlist.Clear();
-		GridMap().swap(gridmap);
-		stepsTotal = 0U;
+		ctx.FreeMemory();
 	}
 
-	inline void SetGrid(FGrid & g)
+	inline void SetGrid(const FGrid & g)
 	{
-		grid = g;
+		grid.SetGrid(g);
 	}
 
 	inline void SetDiagonalMovement(DiagonalMovement d)
@@ -76,11 +94,88 @@ public:
 		dMove = d;
 	}
 
+	inline DiagonalMovement GetDiagonalMovement() const
+	{
+		return dMove;
+	}
+
 	inline void SetSkip(unsigned s)
 	{
 		skip = std::max(s, 1U);
 	}
 
+	// heuristic inflation (weighted JPS); the path found is at most w times longer than the optimal one
+	inline void SetWeight(float w)
+	{
+		weight = std::max(w, 1.0f);
+	}
+
+	// how much FindPathAnytime lowers the weight after every improved path
+	inline void SetWeightStep(float s)
+	{
+		weightStep = std::max(s, 0.01f);
+	}
+
+	/*
+		Any-angle mode (Lazy Theta* over the jump points) of FindPath and the resumable search:
+		a successor optimistically takes the line-of-sight parent of the expanded node, which is verified
+		once the successor itself is expanded, so the paths are lists of any-angle waypoints
+	*/
+	inline void SetAnyAngle(bool a)
+	{
+		anyAngle = a;
+	}
+
+	// region every query is restricted to, the jumps stop at its border; NULL turns it off
+	inline void SetSearchMask(const SearchMask * m)
+	{
+		grid.SetMask(m, grid.GetInnerMask());
+	}
+
+	inline const SearchMask * GetSearchMask() const
+	{
+		return grid.GetMask();
+	}
+
+	/*
+		Clearance of the grid, kept up to date by the caller, and the radius of the agent the next queries are for:
+		the agent, a cube of 2 * Radius + 1 voxels, only stands where it fits, which costs the jumps one load per voxel
+		as the plain cell test does; Radius 0 or a NULL clearance plans for a single voxel
+	*/
+	inline void SetClearance(const Clearance * c, unsigned Radius = 0U)
+	{
+		grid.SetClearance(c, Radius);
+	}
+
+	inline void SetAgentRadius(unsigned Radius)
+	{
+		grid.SetClearance(grid.GetClearance(), Radius);
+	}
+
+	/*
+		Passability classes of the agent the next queries are for, the cells of the grid being bitfields of them:
+		a voxel is free if its cell shares a class with Classes, FGrid::AllClasses treats every non-zero cell as free
+	*/
+	inline void SetClasses(int Classes)
+	{
+		grid.SetClasses(Classes);
+	}
+
+	/*
+		Voxels blocked or freed for the next queries on top of the shared grid, such as the cells other agents occupy;
+		the clearance is not adjusted, so a freed voxel still needs the room of the agent. NULL turns it off
+	*/
+	inline void SetOverlay(const GridOverlay * o)
+	{
+		grid.SetOverlay(o);
+	}
+
+	// component labels of the grid, used to reject unreachable finishes before any expansion; NULL turns it off
+	inline void SetComponents(const Components * c)
+	{
+		components = c;
+	}
+
 	/*
 		Main method of the class;
 		Returns: 1) empty vector - the path does not exist or some exception has been thrown
@@ -89,30 +184,187 @@ public:
 	*/
 	PositionVector FindPath(FPosition Start, FPosition Finish);
 
+	/*
+		FindPath restricted to Mask inside the search mask, for the helpers that search a part of the grid:
+		the voxels outside of either are never entered and their nodes never allocated
+	*/
+	PositionVector FindPath(FPosition Start, FPosition Finish, const SearchMask & Mask);
+
+	// the budgeted FindPath restricted to Mask inside the search mask
+	SearchStatus FindPath(FPosition Start, FPosition Finish, const SearchMask & Mask, const FSearchLimits & Limits, PositionVector & Path);
+
+	// FindPath on the grid with Overlay applied, the grid itself is not touched
+	PositionVector FindPath(FPosition Start, FPosition Finish, const GridOverlay & Overlay);
+
+	/*
+		One-to-many variant of FindPath: a single expansion from the start goes on until Count of the Finishes
+		(all of them by default, 1 for the nearest one) are settled;
+		Returns one path per element of Finishes, in the same order and with the same values as FindPath returns;
+		targets that were not settled get an empty vector
+	*/
+	std::vector<PositionVector> FindPathToMany(FPosition Start, const PositionVector & Finishes, unsigned Count = unsigned(-1));
+
+	/*
+		Resumable search: BeginPath prepares a query and Step advances it by at most maxExpansions expansions
+		or until the deadline, keeping the open list and the nodes between the calls;
+		one Searcher holds one query, so many queries interleave on one thread through several Searchers;
+		Returns: Running - the query is unfinished
+				 Found - GetPath holds the same values as FindPath returns for a found path
+				 NoPath - the path does not exist
+	*/
+	SearchStatus BeginPath(FPosition Start, FPosition Finish);
+	SearchStatus Step(unsigned maxExpansions);
+	SearchStatus Step(std::chrono::steady_clock::time_point deadline);
+
+	inline const PositionVector & GetPath() const
+	{
+		return ctx.resultPath;
+	}
+
+	/*
+		Budgeted variant of FindPath: stops as soon as one of the limits is hit;
+		Returns: 1) Found - Path receives the same values as FindPath returns for a found path
+				 2) NoPath - Path is left empty
+				 3) ExpansionLimit, StepLimit or TimeLimit - Path receives the partial path
+					from the start to the expanded node with the lowest heuristic value
+				 4) Cancelled - Path is left empty and the nodes of the query are freed at once
+	*/
+	SearchStatus FindPath(FPosition Start, FPosition Finish, const FSearchLimits & Limits, PositionVector & Path);
+
+	/*
+		Bidirectional variant of FindPath: a forward frontier from the start and a backward one from the finish
+		are expanded alternately (the one of the lower key first); the jumps of each stop on the voxels the other
+		has closed, so the trees meet where they cross. The costs are octile distances and each direction is led by
+		the average of the distances to its goal and from its start, so the search may end as soon as the two
+		frontier minima prove that no path left is cheaper than the best meeting found; the weight is not applied.
+		FindPath is led by the greedier Manhattan heuristic and expands far fewer nodes for a longer path,
+		so this mode only pays off against the exact search in one direction, and only where that floods;
+		Returns the same values as FindPath
+	*/
+	PositionVector FindPathBidirectional(FPosition Start, FPosition Finish);
+
+	/*
+		Anytime (ARA*) variant of FindPath: finds a path with the heuristic inflated by initialWeight first,
+		then lowers the weight by the weight step and repairs the same search tree to improve the path,
+		until the budget runs out or the path is proven to be within targetBound of the optimal one;
+		Returns the best path found so far (empty if there was no time to find any) and,
+		if achievedBound is given, the ARA* suboptimality bound of that path (infinity if there is no path).
+		The costs and the heuristic are octile distances (DirectionCost), so the heuristic is consistent, but the bound
+		only holds against the paths the search generates: the jump pruning keeps one parent direction per voxel,
+		so the path of a bound of 1 can be longer than the shortest one; the bound is an estimate, not a guarantee
+	*/
+	PositionVector FindPathAnytime(FPosition Start, FPosition Finish, std::chrono::microseconds budget,
+		float initialWeight = 3.0f, float targetBound = 1.0f, float * achievedBound = NULL);
+
+	/*
+		Expansion step for searches that keep their own nodes, such as ParallelSearcher: the jump points reached from p
+		entered from Parent (InvalidPos for the start) under the settings of this Searcher, the jumps stopping at Finish;
+		writes at most 26 positions to Out and returns their count. The current query of the Searcher is not touched
+	*/
+	unsigned Successors(const FPosition & p, const FPosition & Parent, const FPosition & Finish, FPosition * Out);
+
+	// whether a query may start or end at p under the current restrictions
+	inline bool IsPassable(const FPosition & p) const
+	{
+		return grid(p);
+	}
+
+	// false only if the component labels prove that b cannot be reached from a
+	inline bool MayReach(const FPosition & a, const FPosition & b) const
+	{
+		return !isUnreachable(a, b);
+	}
+
+	inline unsigned GetSkip() const
+	{
+		return skip;
+	}
+
+	// the grid searched, without the restrictions set on it
+	inline const FGrid & GetGrid() const
+	{
+		return grid.Base();
+	}
+
+	// whether the agent the queries are for can go straight from a to b, under every restriction set and the diagonal rules
+	inline bool LineOfSight(const FPosition & a, const FPosition & b) const
+	{
+		return grid.IsRestricted() ? JPS::LineOfSight(grid, a, b, dMove) : JPS::LineOfSight(grid.Base(), a, b, dMove);
+	}
+
+	// nodes expanded by the last query, of both directions for FindPathBidirectional
+	inline unsigned GetExpansions() const
+	{
+		return ctx.expansions;
+	}
+
+	/*
+		Everything besides its ends that decides the path of a query, for the caches of paths to tell the settings apart;
+		the grid, the mask, the clearance and the overlay count by address, a cache must be told of edits to them
+	*/
+	struct FSettings
+	{
+		const FGrid * grid;
+		const SearchMask * mask;
+		const SearchMask * inner;
+		const Clearance * clearance;
+		const GridOverlay * overlay;
+		unsigned radius;
+		int classes;
+		DiagonalMovement dMove;
+		unsigned skip;
+		float weight;
+		bool anyAngle;
+
+		inline friend bool operator<(const FSettings & a, const FSettings & b)
+		{
+			return std::tie(a.grid, a.mask, a.inner, a.clearance, a.overlay, a.radius, a.classes, a.dMove, a.skip, a.weight, a.anyAngle) <
+				std::tie(b.grid, b.mask, b.inner, b.clearance, b.overlay, b.radius, b.classes, b.dMove, b.skip, b.weight, b.anyAngle);
+		}
+	};
+
+	inline FSettings GetSettings() const
+	{
+		const FSettings s = { &grid.Base(), grid.GetMask(), grid.GetInnerMask(), grid.GetClearance(), grid.GetOverlay(), grid.GetRadius(), grid.GetClasses(),
+			dMove, skip, weight, anyAngle };
+		return s;
+	}
+
 private:
 
-	FGrid& grid;
+	FGridView grid;
 	DiagonalMovement dMove = DiagonalMovement::Always;
-	Openlist openlist;
-	GridMap gridmap;
-	Node * startNode = NULL;
-	Node * finishNode = NULL;
 	unsigned skip = 1U;
-	unsigned stepsTotal = 0U;
+	const Components * components = NULL;
+	float weight = 1.0f;
+	float weightStep = 0.5f;
+	bool anyAngle = false;
+	// everything the current query writes, the grid is only read
+	FSearchContext ctx;
 
 #pragma region Auxiliary_Private_Methods_Declarations
 
 	Node * getNode(const FPosition & p);
+	void resetNodes(GridMap & m);
+	void swapDirection();
+	unsigned heuristic(const Node * n) const;
+	bool isTarget(const FPosition & p) const;
+	uint64_t cellKey(const FPosition & p) const;
+	float rebuildAnytime(float w);
+	bool isUnreachable(const FPosition & a, const FPosition & b) const;
+	void setVertex(Node * n);
+	SearchStatus stepSearch(unsigned maxExpansions, unsigned maxSteps, std::chrono::steady_clock::time_point deadline, bool timed,
+		const std::atomic<bool> * cancel = NULL);
 	void addToBuf(const unsigned x, const unsigned y, const unsigned z, FPosition *& buf) const;
 	void addToBufCheck(const int x, const int y, const int z, FPosition *& buf) const;
 
-	FPosition jumpXYZ(FPosition p, const int dx, const int dy, const int dz);
-	FPosition jumpXY(FPosition p, const int dx, const int dy);
-	FPosition jumpXZ(FPosition p, const int dx, const int dz);
-	FPosition jumpYZ(FPosition p, const int dy, const int dz);
-	FPosition jumpX(FPosition p, const int dx);
-	FPosition jumpY(FPosition p, const int dy);
-	FPosition jumpZ(FPosition p, const int dz);
+	template <class TGrid> FPosition jumpXYZ(const TGrid & g, FPosition p, const int dx, const int dy, const int dz);
+	template <class TGrid> FPosition jumpXY(const TGrid & g, FPosition p, const int dx, const int dy);
+	template <class TGrid> FPosition jumpXZ(const TGrid & g, FPosition p, const int dx, const int dz);
+	template <class TGrid> FPosition jumpYZ(const TGrid & g, FPosition p, const int dy, const int dz);
+	template <class TGrid> FPosition jumpX(const TGrid & g, FPosition p, const int dx);
+	template <class TGrid> FPosition jumpY(const TGrid & g, FPosition p, const int dy);
+	template <class TGrid> FPosition jumpZ(const TGrid & g, FPosition p, const int dz);
 	
 #pragma endregion
 
@@ -121,6 +373,7 @@ private:
 	inline void IdentifySuccessors(const Node * n);
 	inline unsigned FindNeighbours(const Node * n, FPosition * Buf) const;
 	inline FPosition Jump(const FPosition & Dest, const FPosition & Src);
+	template <class TGrid> FPosition jump(const TGrid & g, const FPosition & Dest, const FPosition & Src);
 	inline PositionVector BacktracePath(const Node * end) const;
 
 #pragma endregion
@@ -129,7 +382,228 @@ private:
 
 inline PositionVector Searcher::FindPath(FPosition Start, FPosition Finish)
 {
-	if (!grid(Start) || !grid(Finish))
+	PositionVector path;
+	FindPath(Start, Finish, FSearchLimits(), path);
+	return path;
+}
+
+inline PositionVector Searcher::FindPath(FPosition Start, FPosition Finish, const SearchMask & Mask)
+{
+	PositionVector path;
+	FindPath(Start, Finish, Mask, FSearchLimits(), path);
+	return path;
+}
+
+inline SearchStatus Searcher::FindPath(FPosition Start, FPosition Finish, const SearchMask & Mask, const FSearchLimits & Limits, PositionVector & Path)
+{
+	const SearchMask * saved = grid.GetInnerMask();
+	grid.SetMask(grid.GetMask(), &Mask);
+	const SearchStatus status = FindPath(Start, Finish, Limits, Path);
+	grid.SetMask(grid.GetMask(), saved);
+	return status;
+}
+
+inline PositionVector Searcher::FindPath(FPosition Start, FPosition Finish, const GridOverlay & Overlay)
+{
+	const GridOverlay * saved = grid.GetOverlay();
+	grid.SetOverlay(&Overlay);
+	PositionVector path = FindPath(Start, Finish);
+	grid.SetOverlay(saved);
+	return path;
+}
+
+inline SearchStatus Searcher::FindPath(FPosition Start, FPosition Finish, const FSearchLimits & Limits, PositionVector & Path)
+{
+	Path.clear();
+
+	SearchStatus status = BeginPath(Start, Finish);
+	if (status == SearchStatus::Running)
+	{
+		const bool timed = Limits.HasTimeLimit();
+		status = stepSearch(Limits.maxExpansions, Limits.maxSteps,
+			timed ? std::chrono::steady_clock::now() + Limits.maxTime : std::chrono::steady_clock::time_point(), timed, Limits.cancel);
+	}
+	if (status == SearchStatus::Cancelled)
+	{
+		// 4) nothing, and no memory kept for a query nobody waits for
+		FreeMemory();
+		return status;
+	}
+	if (status == SearchStatus::ExpansionLimit || status == SearchStatus::StepLimit || status == SearchStatus::TimeLimit)
+	{
+		// 3) best-effort partial path
+		Path = BacktracePath(ctx.closest);
+	}
+	else
+	{
+		// 1) full path or 2) nothing
+		Path.swap(ctx.resultPath);
+	}
+	ctx.queryStatus = SearchStatus::NoPath;
+	return status;
+}
+
+inline SearchStatus Searcher::BeginPath(FPosition Start, FPosition Finish)
+{
+	ctx.resultPath.clear();
+	ctx.closest = NULL;
+	ctx.queryStatus = SearchStatus::NoPath;
+
+	if (!grid(Start) || !grid(Finish) || isUnreachable(Start, Finish))
+	{
+		// the path does not exist
+		return ctx.queryStatus;
+	}
+	if (Start == Finish)
+	{
+		// the start and the finish match
+		ctx.resultPath.push_back(Start);
+		ctx.queryStatus = SearchStatus::Found;
+		return ctx.queryStatus;
+	}
+
+	resetNodes(ctx.gridmap);
+	ctx.lazyTheta = anyAngle;
+	ctx.openlist.Clear();
+	ctx.expansions = 0U;
+
+	Start.Normalize(skip);
+	Finish.Normalize(skip);
+
+	ctx.startNode = getNode(Start);
+	ctx.finishNode = getNode(Finish);
+
+	JPS_ASSERT(ctx.startNode && ctx.finishNode);
+	if (!ctx.startNode || !ctx.finishNode)
+	{
+		// null exception
+		return ctx.queryStatus;
+	}
+
+	ctx.closest = ctx.startNode;
+	ctx.closestH = heuristic(ctx.startNode);
+
+	ctx.openlist.push(ctx.startNode);
+
+	ctx.queryStatus = SearchStatus::Running;
+	return ctx.queryStatus;
+}
+
+inline SearchStatus Searcher::Step(unsigned maxExpansions)
+{
+	if (ctx.queryStatus == SearchStatus::Running)
+	{
+		const SearchStatus s = stepSearch(maxExpansions, unsigned(-1), std::chrono::steady_clock::time_point(), false);
+		ctx.queryStatus = s == SearchStatus::Found || s == SearchStatus::NoPath ? s : SearchStatus::Running;
+	}
+	return ctx.queryStatus;
+}
+
+inline SearchStatus Searcher::Step(std::chrono::steady_clock::time_point deadline)
+{
+	if (ctx.queryStatus == SearchStatus::Running)
+	{
+		const SearchStatus s = stepSearch(unsigned(-1), unsigned(-1), deadline, true);
+		ctx.queryStatus = s == SearchStatus::Found || s == SearchStatus::NoPath ? s : SearchStatus::Running;
+	}
+	return ctx.queryStatus;
+}
+
+inline std::vector<PositionVector> Searcher::FindPathToMany(FPosition Start, const PositionVector & Finishes, unsigned Count)
+{
+	std::vector<PositionVector> paths(Finishes.size());
+	if (!grid(Start) || Finishes.empty() || !Count)
+	{
+		// the paths do not exist
+		return paths;
+	}
+
+	resetNodes(ctx.gridmap);
+	ctx.lazyTheta = anyAngle;
+	ctx.openlist.Clear();
+	ctx.expansions = 0U;
+	ctx.targets.clear();
+
+	Start.Normalize(skip);
+	ctx.startNode = getNode(Start);
+	ctx.finishNode = NULL;
+
+	std::map<FPosition, PositionVector> settled;
+	for (unsigned i = 0; i < Finishes.size(); ++i)
+	{
+		FPosition f = Finishes[i];
+		if (!grid(f) || isUnreachable(Start, f))
+		{
+			continue;
+		}
+		f.Normalize(skip);
+		if (f == Start)
+		{
+			// the start and the finish match
+			settled[f].push_back(Start);
+		}
+		else if (getNode(f))
+		{
+			ctx.targets.insert(f);
+		}
+	}
+
+	JPS_ASSERT(ctx.startNode);
+	if (ctx.startNode && !ctx.targets.empty() && settled.size() < Count)
+	{
+		// the jumps still need a finish, the first target is as good as any
+		ctx.finishNode = getNode(*ctx.targets.begin());
+
+		ctx.openlist.push(ctx.startNode);
+
+		while (!ctx.openlist.Empty())
+		{
+			Node * cur = ctx.openlist.pop();
+			cur->SetClosed();
+			if (ctx.lazyTheta)
+			{
+				setVertex(cur);
+			}
+			if (ctx.targets.erase(cur->pos))
+			{
+				settled[cur->pos] = BacktracePath(cur);
+				if (ctx.targets.empty() || settled.size() >= Count)
+				{
+					break;
+				}
+				// the nearest target has changed, reorder the open list
+				for (GridMap::iterator it = ctx.gridmap.begin(); it != ctx.gridmap.end(); ++it)
+				{
+					Node & n = it->second;
+					if (n.IsOpen() && !n.IsClosed())
+					{
+						n.F = n.G + unsigned(weight * heuristic(&n));
+					}
+				}
+				ctx.openlist.heapify();
+			}
+			IdentifySuccessors(cur);
+			++ctx.expansions;
+		}
+	}
+	ctx.targets.clear();
+
+	for (unsigned i = 0; i < Finishes.size(); ++i)
+	{
+		FPosition f = Finishes[i];
+		f.Normalize(skip);
+		std::map<FPosition, PositionVector>::const_iterator it = settled.find(f);
+		if (it != settled.end() && grid(Finishes[i]))
+		{
+			paths[i] = it->second;
+		}
+	}
+	return paths;
+}
+
+inline PositionVector Searcher::FindPathBidirectional(FPosition Start, FPosition Finish)
+{
+	if (!grid(Start) || !grid(Finish) || isUnreachable(Start, Finish))
 	{
 		// 1) the path does not exist
 		return PositionVector();
@@ -142,43 +616,200 @@ inline PositionVector Searcher::FindPath(FPosition Start, FPosition Finish)
 		return v;
 	}
 
-	for (GridMap::iterator it = gridmap.begin(); it != gridmap.end(); ++it)
+	resetNodes(ctx.gridmap);
+	resetNodes(ctx.gridmapB);
+	ctx.lazyTheta = false;
+	ctx.openlist.Clear();
+	ctx.openlistB.Clear();
+	ctx.closed.clear();
+	ctx.closedB.clear();
+	ctx.meet = InvalidPos;
+	ctx.meetCost = unsigned(-1);
+	ctx.expansions = 0U;
+
+	Start.Normalize(skip);
+	Finish.Normalize(skip);
+
+	// backward direction first, so the forward one stays active afterwards
+	swapDirection();
+	ctx.startNode = getNode(Finish);
+	ctx.finishNode = getNode(Start);
+	swapDirection();
+	ctx.startNode = getNode(Start);
+	ctx.finishNode = getNode(Finish);
+
+	JPS_ASSERT(ctx.startNode && ctx.finishNode && ctx.startNodeB && ctx.finishNodeB);
+	if (!ctx.startNode || !ctx.finishNode || !ctx.startNodeB || !ctx.finishNodeB)
+	{
+		// 1) null exception
+		return PositionVector();
+	}
+
+	ctx.bidirectional = true;
+	const unsigned span = DirectionDistance(Start, Finish);
+	ctx.startNode->F = 2U * span;
+	ctx.startNode->SetOpen();
+	ctx.openlist.push(ctx.startNode);
+	ctx.startNodeB->F = 2U * span;
+	ctx.startNodeB->SetOpen();
+	ctx.openlistB.push(ctx.startNodeB);
+
+	bool backward = false;
+	while (!ctx.openlist.Empty() && !ctx.openlistB.Empty())
+	{
+		// meet-in-the-middle stopping rule: with the averaged heuristics the keys of the two directions add up
+		// to twice a lower bound of the cost of any path that still passes both frontiers, plus twice the span
+		if (ctx.meet.IsValid() && uint64_t(ctx.openlist.top()->F) + ctx.openlistB.top()->F >= 2U * (uint64_t(ctx.meetCost) + span))
+		{
+			break;
+		}
+
+		// expand the direction of the lower key, so both get about halfway
+		if (ctx.openlistB.top()->F < ctx.openlist.top()->F)
+		{
+			swapDirection();
+			backward = !backward;
+		}
+
+		Node * cur = ctx.openlist.pop();
+		cur->SetClosed();
+		ctx.closed.insert(cellKey(cur->pos));
+
+		IdentifySuccessors(cur);
+		++ctx.expansions;
+	}
+
+	if (backward)
+	{
+		swapDirection();
+	}
+	ctx.bidirectional = false;
+	const FPosition meet = ctx.meet;
+
+	if (!meet.IsValid())
+	{
+		// 1) the path does not exist
+		return PositionVector();
+	}
+
+	// 3) full path: start -> meet from the forward tree, meet -> finish from the backward one
+	PositionVector path;
+	for (const Node * n = &ctx.gridmap.find(meet)->second; n; n = n->parent)
+	{
+		path.push_back(n->pos);
+	}
+	std::reverse(path.begin(), path.end());
+	for (const Node * n = ctx.gridmapB.find(meet)->second.parent; n; n = n->parent)
+	{
+		path.push_back(n->pos);
+	}
+	return path;
+}
+
+inline PositionVector Searcher::FindPathAnytime(FPosition Start, FPosition Finish, std::chrono::microseconds budget,
+	float initialWeight, float targetBound, float * achievedBound)
+{
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + budget;
+	float bound = std::numeric_limits<float>::infinity();
+
+	if (!grid(Start) || !grid(Finish) || isUnreachable(Start, Finish))
+	{
+		// 1) the path does not exist
+		if (achievedBound)
+		{
+			*achievedBound = bound;
+		}
+		return PositionVector();
+	}
+	if (Start == Finish)
 	{
-		it->second.ResetState();
+		// 2) the start and the finish match
+		if (achievedBound)
+		{
+			*achievedBound = 1.0f;
+		}
+		PositionVector v;
+		v.push_back(Start);
+		return v;
 	}
-	openlist.Clear();
+
+	resetNodes(ctx.gridmap);
+	ctx.lazyTheta = false;
+	ctx.openlist.Clear();
+	ctx.expansions = 0U;
 
 	Start.Normalize(skip);
 	Finish.Normalize(skip);
 
-	startNode = getNode(Start);
-	finishNode = getNode(Finish);
+	ctx.startNode = getNode(Start);
+	ctx.finishNode = getNode(Finish);
 
-	JPS_ASSERT(startNode && finishNode);
-	if (!startNode || !finishNode)
+	JPS_ASSERT(ctx.startNode && ctx.finishNode);
+	if (!ctx.startNode || !ctx.finishNode)
 	{
 		// 1) null exception
+		if (achievedBound)
+		{
+			*achievedBound = bound;
+		}
 		return PositionVector();
 	}
 
-	grid.SetStart(Start);
-	grid.SetFinish(Finish);
+	const float savedWeight = weight;
+	float w = std::max(initialWeight, 1.0f);
+	weight = w;
+	ctx.anytime = true;
 
-	openlist.push(startNode);
+	ctx.startNode->SetOpen();
+	ctx.openlist.push(ctx.startNode);
 
-	while (!openlist.Empty())
+	PositionVector path;
+	while (true)
 	{
-		Node * cur = openlist.pop();
-		cur->SetClosed();
-		if (cur == finishNode)
+		// ImprovePath
+		bool expired = false;
+		while (!ctx.openlist.Empty() && !(ctx.finishNode->IsOpen() && ctx.finishNode->G <= ctx.openlist.top()->F))
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				expired = true;
+				break;
+			}
+			Node * cur = ctx.openlist.pop();
+			cur->SetClosed();
+			IdentifySuccessors(cur);
+			++ctx.expansions;
+		}
+		if (expired || !ctx.finishNode->IsOpen())
 		{
-			// 3) full path
-			return BacktracePath(cur);
+			// out of time, or 1) the path does not exist
+			break;
 		}
-		IdentifySuccessors(cur);
+
+		// 3) full path for the current weight
+		path = BacktracePath(ctx.finishNode);
+		bound = w;
+		if (w <= 1.0f || w <= targetBound || std::chrono::steady_clock::now() >= deadline)
+		{
+			break;
+		}
+
+		w = std::max(w - weightStep, 1.0f);
+		bound = std::min(bound, rebuildAnytime(w));
+		if (bound <= targetBound)
+		{
+			break;
+		}
+	}
+
+	ctx.anytime = false;
+	weight = savedWeight;
+
+	if (achievedBound)
+	{
+		*achievedBound = bound;
 	}
-	// 1) the path does not exist
-	return PositionVector();
+	return path;
 }
 
 #pragma region Auxiliary_Private_Methods_Definitions
@@ -190,7 +821,182 @@ inline Node * Searcher::getNode(const FPosition & p)
 	{
 		return NULL;
 	}
-	return &gridmap.insert(std::make_pair(p, Node(p))).first->second;
+	return &ctx.gridmap.insert(std::make_pair(p, Node(p))).first->second;
+}
+
+// the nodes of the last query are dropped, resetting them would cost every query all the nodes a context has ever held
+inline void Searcher::resetNodes(GridMap & m)
+{
+	m.clear();
+}
+
+/*
+	O(1) rejection through the component labels; they describe single-voxel moves,
+	so they are only trusted when the searcher moves the same way and does not skip voxels
+*/
+// the labels are of the bare grid, an overlay that frees voxels may connect what they keep apart
+inline bool Searcher::isUnreachable(const FPosition & a, const FPosition & b) const
+{
+	return components && skip == 1U && components->GetDiagonalMovement() == dMove && !(grid.GetOverlay() && grid.GetOverlay()->FreesAny()) &&
+		!components->IsReachable(a, b);
+}
+
+/*
+	Lazy Theta*: the parent a node was queued with is only assumed to see it;
+	if the line of sight is blocked, the node falls back to the jump point that generated it,
+	whose straight segment is always free
+*/
+inline void Searcher::setVertex(Node * n)
+{
+	const Node * a = n->anyParent;
+	if (!a || a == n->parent || JPS::LineOfSight(grid, a->pos, n->pos, dMove))
+	{
+		return;
+	}
+	n->anyParent = n->parent;
+	n->G = n->parent->G + Euclidean(n, n->parent);
+}
+
+inline void Searcher::swapDirection()
+{
+	ctx.openlist.Swap(ctx.openlistB);
+	ctx.gridmap.swap(ctx.gridmapB);
+	std::swap(ctx.startNode, ctx.startNodeB);
+	std::swap(ctx.finishNode, ctx.finishNodeB);
+	ctx.closed.swap(ctx.closedB);
+}
+
+/*
+	Main loop of the resumable search, runs until the query finishes or one of the limits is hit;
+	Returns: Found, NoPath or the limit that stopped it
+*/
+inline SearchStatus Searcher::stepSearch(unsigned maxExpansions, unsigned maxSteps, std::chrono::steady_clock::time_point deadline, bool timed,
+	const std::atomic<bool> * cancel)
+{
+	const unsigned stepsBegin = ctx.stepsTotal;
+	unsigned expansions = 0U;
+
+	while (!ctx.openlist.Empty())
+	{
+		if (expansions >= maxExpansions)
+		{
+			return SearchStatus::ExpansionLimit;
+		}
+		if (ctx.stepsTotal - stepsBegin >= maxSteps)
+		{
+			return SearchStatus::StepLimit;
+		}
+		if (timed && std::chrono::steady_clock::now() >= deadline)
+		{
+			return SearchStatus::TimeLimit;
+		}
+		if (cancel && cancel->load(std::memory_order_relaxed))
+		{
+			return SearchStatus::Cancelled;
+		}
+
+		Node * cur = ctx.openlist.pop();
+		cur->SetClosed();
+		if (ctx.lazyTheta)
+		{
+			setVertex(cur);
+		}
+		if (cur == ctx.finishNode)
+		{
+			ctx.resultPath = BacktracePath(cur);
+			return SearchStatus::Found;
+		}
+
+		const unsigned h = heuristic(cur);
+		if (h < ctx.closestH || (h == ctx.closestH && cur->G < ctx.closest->G))
+		{
+			ctx.closest = cur;
+			ctx.closestH = h;
+		}
+
+		IdentifySuccessors(cur);
+		++expansions;
+		++ctx.expansions;
+	}
+	return SearchStatus::NoPath;
+}
+
+// the anytime mode measures the octile distance, the exact cost of a jump and never more than the cost of a path,
+// the bidirectional one averages the octile distances to the finish and from the start, doubled to stay integral
+// (F = 2 G + H, the same order for both directions), the any-angle mode the straight-line distance;
+// a one-to-many search heads for the nearest unsettled target
+inline unsigned Searcher::heuristic(const Node * n) const
+{
+	if (!ctx.targets.empty())
+	{
+		unsigned h = unsigned(-1);
+		for (TargetSet::const_iterator it = ctx.targets.begin(); it != ctx.targets.end(); ++it)
+		{
+			h = std::min(h, unsigned(abs(int(n->pos.x - it->x)) + abs(int(n->pos.y - it->y)) + abs(int(n->pos.z - it->z))));
+		}
+		return h;
+	}
+	if (ctx.bidirectional)
+	{
+		return DirectionDistance(n->pos, ctx.finishNode->pos) + DirectionDistance(ctx.startNode->pos, ctx.finishNode->pos) -
+			DirectionDistance(n->pos, ctx.startNode->pos);
+	}
+	if (ctx.anytime)
+	{
+		return DirectionDistance(n->pos, ctx.finishNode->pos);
+	}
+	return ctx.lazyTheta ? Euclidean(n, ctx.finishNode) : Manhattan(n, ctx.finishNode);
+}
+
+// the bidirectional search also stops the jumps on the voxels the other direction has closed, where the two trees cross
+inline bool Searcher::isTarget(const FPosition & p) const
+{
+	return (!ctx.targets.empty() && ctx.targets.find(p) != ctx.targets.end()) ||
+		(ctx.bidirectional && ctx.closedB.find(cellKey(p)) != ctx.closedB.end());
+}
+
+inline uint64_t Searcher::cellKey(const FPosition & p) const
+{
+	return (uint64_t(p.z) * grid.Base().y + p.y) * grid.Base().x + p.x;
+}
+
+/*
+	Prepares the next ARA* iteration with the weight w: inconsistent nodes are moved back to the open list,
+	the other closed nodes become stale and the open list is reordered with the new weight;
+	Returns the suboptimality bound of the current path, G(finish) / min(G + H) over the open and inconsistent nodes
+*/
+inline float Searcher::rebuildAnytime(float w)
+{
+	unsigned minF = unsigned(-1);
+	for (GridMap::iterator it = ctx.gridmap.begin(); it != ctx.gridmap.end(); ++it)
+	{
+		Node & n = it->second;
+		if (!n.IsOpen() || n.IsStale())
+		{
+			continue;
+		}
+		if (n.IsClosed() && !n.IsIncons())
+		{
+			n.SetStale();
+			continue;
+		}
+
+		const unsigned h = heuristic(&n);
+		minF = std::min(minF, n.G + h);
+		n.F = n.G + unsigned(w * h);
+		if (n.IsClosed())
+		{
+			n.Reopen();
+			ctx.openlist.push(&n);
+		}
+	}
+	ctx.openlist.heapify();
+
+	if (minF == unsigned(-1) || minF == 0U)
+	{
+		return 1.0f;
+	}
+	return std::max(float(ctx.finishNode->G) / float(minF), 1.0f);
 }
 
 inline void Searcher::addToBuf(const unsigned x, const unsigned y, const unsigned z, FPosition *& buf) const
@@ -209,15 +1015,16 @@ inline void Searcher::addToBufCheck(const int x, const int y, const int z, FPosi
 
 #pragma region Jumps
 // partially ready
-inline FPosition Searcher::jumpXYZ(FPosition p, const int dx, const int dy, const int dz)
+template <class TGrid>
+inline FPosition Searcher::jumpXYZ(const TGrid & g, FPosition p, const int dx, const int dy, const int dz)
 {
-	JPS_ASSERT(grid(p) && dx && dy && dz);
-	if (!(grid(p) && dx && dy && dz))
+	JPS_ASSERT(g(p) && dx && dy && dz);
+	if (!(g(p) && dx && dy && dz))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 
 	switch (dMove)
@@ -225,7 +1032,7 @@ inline FPosition Searcher::jumpXYZ(FPosition p, const int dx, const int dy, cons
 		case DiagonalMovement::Always:
 			while (true)
 			{
-				if (p == finpos)
+				if (p == finpos || isTarget(p))
 				{
 					break;
 				}
@@ -240,12 +1047,12 @@ inline FPosition Searcher::jumpXYZ(FPosition p, const int dx, const int dy, cons
 				{
 					// 3D
 					{
-						if (grid(x - dx, y + dy, z + dz) && !grid(x - dx, y, z) ||
-							grid(x + dx, y - dy, z + dz) && !grid(x, y - dy, z) ||
-							grid(x + dx, y + dy, z - dz) && !grid(x, y, z - dz) ||
-							grid(x - dx, y - dy, z + dz) && !grid(x - dx, y - dy, z) && !grid(x - dx, y, z) && !grid(x, y - dy, z) ||
-							grid(x - dx, y + dy, z - dz) && !grid(x - dx, y, z - dz) && !grid(x - dx, y, z) && !grid(x, y, z - dz) ||
-							grid(x + dx, y - dy, z - dz) && !grid(x, y - dy, z - dz) && !grid(x, y - dy, z) && !grid(x, y, z - dz))
+						if (g(x - dx, y + dy, z + dz) && !g(x - dx, y, z) ||
+							g(x + dx, y - dy, z + dz) && !g(x, y - dy, z) ||
+							g(x + dx, y + dy, z - dz) && !g(x, y, z - dz) ||
+							g(x - dx, y - dy, z + dz) && !g(x - dx, y - dy, z) && !g(x - dx, y, z) && !g(x, y - dy, z) ||
+							g(x - dx, y + dy, z - dz) && !g(x - dx, y, z - dz) && !g(x - dx, y, z) && !g(x, y, z - dz) ||
+							g(x + dx, y - dy, z - dz) && !g(x, y - dy, z - dz) && !g(x, y - dy, z) && !g(x, y, z - dz))
 						{
 							break;
 						}
@@ -253,12 +1060,12 @@ inline FPosition Searcher::jumpXYZ(FPosition p, const int dx, const int dy, cons
 					// !3D
 					// 2D
 					{
-						if (grid(x - dx, y + dy, z) && !grid(x - dx, y, z) && !grid(x - dx, y, z - dz) ||
-							grid(x - dx, y, z + dz) && !grid(x - dx, y, z) && !grid(x - dx, y - dy, z) ||
-							grid(x + dx, y - dy, z) && !grid(x, y - dy, z) && !grid(x, y - dy, z - dz) ||
-							grid(x, y - dy, z + dz) && !grid(x, y - dy, z) && !grid(x - dx, y - dy, z) ||
-							grid(x + dx, y, z - dz) && !grid(x, y, z - dz) && !grid(x, y - dy, z - dz) ||
-							grid(x, y + dy, z - dz) && !grid(x, y, z - dz) && !grid(x - dx, y, z - dz))
+						if (g(x - dx, y + dy, z) && !g(x - dx, y, z) && !g(x - dx, y, z - dz) ||
+							g(x - dx, y, z + dz) && !g(x - dx, y, z) && !g(x - dx, y - dy, z) ||
+							g(x + dx, y - dy, z) && !g(x, y - dy, z) && !g(x, y - dy, z - dz) ||
+							g(x, y - dy, z + dz) && !g(x, y - dy, z) && !g(x - dx, y - dy, z) ||
+							g(x + dx, y, z - dz) && !g(x, y, z - dz) && !g(x, y - dy, z - dz) ||
+							g(x, y + dy, z - dz) && !g(x, y, z - dz) && !g(x - dx, y, z - dz))
 						{
 							break;
 						}
@@ -269,35 +1076,35 @@ inline FPosition Searcher::jumpXYZ(FPosition p, const int dx, const int dy, cons
 
 				// recursion
 				{
-					if (grid(x + dx, y, z) && jumpX(NewPos(x + dx, y, z), dx).IsValid())
+					if (g(x + dx, y, z) && jumpX(g, NewPos(x + dx, y, z), dx).IsValid())
 					{
 						break;
 					}
-					if (grid(x, y + dy, z) && jumpY(NewPos(x, y + dy, z), dy).IsValid())
+					if (g(x, y + dy, z) && jumpY(g, NewPos(x, y + dy, z), dy).IsValid())
 					{
 						break;
 					}
-					if (grid(x, y, z + dz) && jumpZ(NewPos(x, y, z + dz), dz).IsValid())
+					if (g(x, y, z + dz) && jumpZ(g, NewPos(x, y, z + dz), dz).IsValid())
 					{
 						break;
 					}
 
-					if (grid(x + dx, y + dy, z) && jumpXY(NewPos(x + dx, y + dy, z), dx, dy).IsValid())
+					if (g(x + dx, y + dy, z) && jumpXY(g, NewPos(x + dx, y + dy, z), dx, dy).IsValid())
 					{
 						break;
 					}
-					if (grid(x + dx, y, z + dz) && jumpXZ(NewPos(x + dx, y, z + dz), dx, dz).IsValid())
+					if (g(x + dx, y, z + dz) && jumpXZ(g, NewPos(x + dx, y, z + dz), dx, dz).IsValid())
 					{
 						break;
 					}
-					if (grid(x, y + dy, z + dz) && jumpYZ(NewPos(x, y + dy, z + dz), dy, dz).IsValid())
+					if (g(x, y + dy, z + dz) && jumpYZ(g, NewPos(x, y + dy, z + dz), dy, dz).IsValid())
 					{
 						break;
 					}
 				}
 				// !recursion
 
-				if (grid(x + dx, y + dy, z + dz))
+				if (g(x + dx, y + dy, z + dz))
 				{
 					p.x += dx;
 					p.y += dy;
@@ -312,22 +1119,23 @@ inline FPosition Searcher::jumpXYZ(FPosition p, const int dx, const int dy, cons
 			break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
 
 #pragma region 2D_Jumps
 
-inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
+template <class TGrid>
+inline FPosition Searcher::jumpXY(const TGrid & g, FPosition p, const int dx, const int dy)
 {
-	JPS_ASSERT(grid(p) && dx && dy);
-	if (!(grid(p) && dx && dy))
+	JPS_ASSERT(g(p) && dx && dy);
+	if (!(g(p) && dx && dy))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 	const int cskip = this->skip;
 
@@ -336,7 +1144,7 @@ inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
 		case DiagonalMovement::Always:
 			while (true)
 			{
-				if (p == finpos)
+				if (p == finpos || isTarget(p))
 				{
 					break;
 				}
@@ -349,8 +1157,8 @@ inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
 
 				// forced
 				{
-					if (grid(x - dx, y + dy, z) && !grid(x - dx, y, z) ||
-						grid(x + dx, y - dy, z) && !grid(x, y - dy, z))
+					if (g(x - dx, y + dy, z) && !g(x - dx, y, z) ||
+						g(x + dx, y - dy, z) && !g(x, y - dy, z))
 					{
 						break;
 					}
@@ -359,13 +1167,13 @@ inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
 					for (int tdz = -cskip; tdz < cskip + 1; tdz += (cskip << 1))
 					{
 						const int zz = z + tdz;
-						if (!grid(x, y, zz))
+						if (!g(x, y, zz))
 						{
-							if (grid(x + dx, y, zz) ||
-								grid(x, y + dy, zz) ||
-								grid(x + dx, y + dy, zz) ||
-								grid(x + dx, y - dy, zz) && !grid(x, y - dy, zz) && !grid(x, y - dy, z) ||
-								grid(x - dx, y + dy, zz) && !grid(x - dx, y, zz) && !grid(x - dx, y, z))
+							if (g(x + dx, y, zz) ||
+								g(x, y + dy, zz) ||
+								g(x + dx, y + dy, zz) ||
+								g(x + dx, y - dy, zz) && !g(x, y - dy, zz) && !g(x, y - dy, z) ||
+								g(x - dx, y + dy, zz) && !g(x - dx, y, zz) && !g(x - dx, y, z))
 							{
 								tcheck = true;
 								break;
@@ -381,18 +1189,18 @@ inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
 
 				// recursion
 				{
-					if (grid(x + dx, y, z) && jumpX(NewPos(x + dx, y, z), dx).IsValid())
+					if (g(x + dx, y, z) && jumpX(g, NewPos(x + dx, y, z), dx).IsValid())
 					{
 						break;
 					}
-					if (grid(x, y + dy, z) && jumpY(NewPos(x, y + dy, z), dy).IsValid())
+					if (g(x, y + dy, z) && jumpY(g, NewPos(x, y + dy, z), dy).IsValid())
 					{
 						break;
 					}
 				}
 				// !recursion
 
-				if (grid(x + dx, y + dy, z))
+				if (g(x + dx, y + dy, z))
 				{
 					p.x += dx;
 					p.y += dy;
@@ -412,7 +1220,7 @@ inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
 			/*
 			while (true)
 			{
-			if (p == finpos)
+			if (p == finpos || isTarget(p))
 			{
 			break;
 			}
@@ -431,20 +1239,21 @@ inline FPosition Searcher::jumpXY(FPosition p, const int dx, const int dy)
 			break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
 
-inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
+template <class TGrid>
+inline FPosition Searcher::jumpXZ(const TGrid & g, FPosition p, const int dx, const int dz)
 {
-	JPS_ASSERT(grid(p) && dx && dz);
-	if (!(grid(p) && dx && dz))
+	JPS_ASSERT(g(p) && dx && dz);
+	if (!(g(p) && dx && dz))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 	const int cskip = this->skip;
 
@@ -453,7 +1262,7 @@ inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
 		case DiagonalMovement::Always:
 			while (true)
 			{
-				if (p == finpos)
+				if (p == finpos || isTarget(p))
 				{
 					break;
 				}
@@ -466,8 +1275,8 @@ inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
 
 				// forced
 				{
-					if (grid(x - dx, y, z + dz) && !grid(x - dx, y, z) ||
-						grid(x + dx, y, z - dz) && !grid(x, y, z - dz))
+					if (g(x - dx, y, z + dz) && !g(x - dx, y, z) ||
+						g(x + dx, y, z - dz) && !g(x, y, z - dz))
 					{
 						break;
 					}
@@ -481,13 +1290,13 @@ inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
 					for (int tdy = -cskip; tdy < cskip + 1; tdy += (cskip << 1))
 					{
 						const int yy = y + tdy;
-						if (!grid(x, yy, z))
+						if (!g(x, yy, z))
 						{
-							if (grid(x + dx, yy, z) ||
-								grid(x, yy, z + dz) ||
-								grid(x + dx, yy, z + dz) ||
-								grid(x + dx, yy, z - dz) && !grid(x, yy, z - dz) && !grid(x, y, z - dz) ||
-								grid(x - dx, yy, z + dz) && !grid(x - dx, yy, z) && !grid(x - dx, y, z))
+							if (g(x + dx, yy, z) ||
+								g(x, yy, z + dz) ||
+								g(x + dx, yy, z + dz) ||
+								g(x + dx, yy, z - dz) && !g(x, yy, z - dz) && !g(x, y, z - dz) ||
+								g(x - dx, yy, z + dz) && !g(x - dx, yy, z) && !g(x - dx, y, z))
 							{
 								tcheck = true;
 								break;
@@ -503,18 +1312,18 @@ inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
 
 				// recursion
 				{
-					if (grid(x + dx, y, z) && jumpX(NewPos(x + dx, y, z), dx).IsValid())
+					if (g(x + dx, y, z) && jumpX(g, NewPos(x + dx, y, z), dx).IsValid())
 					{
 						break;
 					}
-					if (grid(x, y, z + dz) && jumpZ(NewPos(x, y, z + dz), dz).IsValid())
+					if (g(x, y, z + dz) && jumpZ(g, NewPos(x, y, z + dz), dz).IsValid())
 					{
 						break;
 					}
 				}
 				// !recursion
 
-				if (grid(x + dx, y, z + dz))
+				if (g(x + dx, y, z + dz))
 				{
 					p.x += dx;
 					p.z += dz;
@@ -534,7 +1343,7 @@ inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
 			/*
 			while (true)
 			{
-				if (p == finpos)
+				if (p == finpos || isTarget(p))
 				{
 					break;
 				}
@@ -553,20 +1362,21 @@ inline FPosition Searcher::jumpXZ(FPosition p, const int dx, const int dz)
 			break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
 
-inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
+template <class TGrid>
+inline FPosition Searcher::jumpYZ(const TGrid & g, FPosition p, const int dy, const int dz)
 {
-	JPS_ASSERT(grid(p) && dy && dz);
-	if (!(grid(p) && dy && dz))
+	JPS_ASSERT(g(p) && dy && dz);
+	if (!(g(p) && dy && dz))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 	const int cskip = this->skip;
 
@@ -575,7 +1385,7 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 		case DiagonalMovement::Always:
 			while (true)
 			{
-				if (p == finpos)
+				if (p == finpos || isTarget(p))
 				{
 					break;
 				}
@@ -588,8 +1398,8 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 	
 				// forced
 				{
-					if (grid(x, y - dy, z + dz) && !grid(x, y - dy, z) ||
-						grid(x, y + dy, z - dz) && !grid(x, y, z - dz))
+					if (g(x, y - dy, z + dz) && !g(x, y - dy, z) ||
+						g(x, y + dy, z - dz) && !g(x, y, z - dz))
 					{
 						break;
 					}
@@ -603,13 +1413,13 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 					for (int tdx = -cskip; tdx < cskip + 1; tdx += (cskip << 1))
 					{
 						const int xx = x + tdx;
-						if (!grid(xx, y, z))
+						if (!g(xx, y, z))
 						{
-							if (grid(xx, y + dy, z) ||
-								grid(xx, y, z + dz) ||
-								grid(xx, y + dy, z + dz) ||
-								grid(xx, y + dy, z - dz) && !grid(xx, y, z - dz) && !grid(x, y, z - dz) ||
-								grid(xx, y - dy, z + dz) && !grid(xx, y - dy, z) && !grid(x, y - dy, z))
+							if (g(xx, y + dy, z) ||
+								g(xx, y, z + dz) ||
+								g(xx, y + dy, z + dz) ||
+								g(xx, y + dy, z - dz) && !g(xx, y, z - dz) && !g(x, y, z - dz) ||
+								g(xx, y - dy, z + dz) && !g(xx, y - dy, z) && !g(x, y - dy, z))
 							{
 								tcheck = true;
 								break;
@@ -625,18 +1435,18 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 
 				// recursion
 				{
-					if (grid(x, y + dy, z) && jumpY(NewPos(x, y + dy, z), dy).IsValid())
+					if (g(x, y + dy, z) && jumpY(g, NewPos(x, y + dy, z), dy).IsValid())
 					{
 						break;
 					}
-					if (grid(x, y, z + dz) && jumpZ(NewPos(x, y, z + dz), dz).IsValid())
+					if (g(x, y, z + dz) && jumpZ(g, NewPos(x, y, z + dz), dz).IsValid())
 					{
 						break;
 					}
 				}
 				// !recursion
 
-				if (grid(x, y + dy, z + dz))
+				if (g(x, y + dy, z + dz))
 				{
 					p.y += dy;
 					p.z += dz;
@@ -656,7 +1466,7 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 			/*
 			while (true)
 			{
-				if (p == finpos)
+				if (p == finpos || isTarget(p))
 				{
 					break;
 				}
@@ -675,7 +1485,7 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 			break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
@@ -684,15 +1494,16 @@ inline FPosition Searcher::jumpYZ(FPosition p, const int dy, const int dz)
 
 #pragma region 1D_Jumps
 
-inline FPosition Searcher::jumpX(FPosition p, const int dx)
+template <class TGrid>
+inline FPosition Searcher::jumpX(const TGrid & g, FPosition p, const int dx)
 {
-	JPS_ASSERT(grid(p) && dx);
-	if (!(grid(p) && dx))
+	JPS_ASSERT(g(p) && dx);
+	if (!(g(p) && dx))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 	const int cskip = this->skip;
 
@@ -701,7 +1512,7 @@ inline FPosition Searcher::jumpX(FPosition p, const int dx)
 	case DiagonalMovement::Always:
 		while (true)
 		{
-			if (p == finpos)
+			if (p == finpos || isTarget(p))
 			{
 				break;
 			}
@@ -715,21 +1526,21 @@ inline FPosition Searcher::jumpX(FPosition p, const int dx)
 			// forced
 			{
 				const int xx = x + dx;
-				if (grid(xx, y + cskip, z) && !grid(x, y + cskip, z) ||
-					grid(xx, y - cskip, z) && !grid(x, y - cskip, z) ||
-					grid(xx, y, z + cskip) && !grid(x, y, z + cskip) ||
-					grid(xx, y, z - cskip) && !grid(x, y, z - cskip) ||
-					grid(xx, y + cskip, z + cskip) && !grid(x, y + cskip, z + cskip) && !grid(x, y + cskip, z) && !grid(x, y, z + cskip) ||
-					grid(xx, y - cskip, z + cskip) && !grid(x, y - cskip, z + cskip) && !grid(x, y - cskip, z) && !grid(x, y, z + cskip) ||
-					grid(xx, y + cskip, z - cskip) && !grid(x, y + cskip, z - cskip) && !grid(x, y + cskip, z) && !grid(x, y, z - cskip) ||
-					grid(xx, y - cskip, z - cskip) && !grid(x, y - cskip, z - cskip) && !grid(x, y - cskip, z) && !grid(x, y, z - cskip))
+				if (g(xx, y + cskip, z) && !g(x, y + cskip, z) ||
+					g(xx, y - cskip, z) && !g(x, y - cskip, z) ||
+					g(xx, y, z + cskip) && !g(x, y, z + cskip) ||
+					g(xx, y, z - cskip) && !g(x, y, z - cskip) ||
+					g(xx, y + cskip, z + cskip) && !g(x, y + cskip, z + cskip) && !g(x, y + cskip, z) && !g(x, y, z + cskip) ||
+					g(xx, y - cskip, z + cskip) && !g(x, y - cskip, z + cskip) && !g(x, y - cskip, z) && !g(x, y, z + cskip) ||
+					g(xx, y + cskip, z - cskip) && !g(x, y + cskip, z - cskip) && !g(x, y + cskip, z) && !g(x, y, z - cskip) ||
+					g(xx, y - cskip, z - cskip) && !g(x, y - cskip, z - cskip) && !g(x, y - cskip, z) && !g(x, y, z - cskip))
 				{
 					break;
 				}
 			}
 			// !forced
 
-			if (grid(x + dx, y, z))
+			if (g(x + dx, y, z))
 			{
 				p.x += dx;
 			}
@@ -748,7 +1559,7 @@ inline FPosition Searcher::jumpX(FPosition p, const int dx)
 		/*
 		while (true)
 		{
-			if (p == finpos)
+			if (p == finpos || isTarget(p))
 			{
 				break;
 			}
@@ -767,20 +1578,21 @@ inline FPosition Searcher::jumpX(FPosition p, const int dx)
 		break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
 
-inline FPosition Searcher::jumpY(FPosition p, const int dy)
+template <class TGrid>
+inline FPosition Searcher::jumpY(const TGrid & g, FPosition p, const int dy)
 {
-	JPS_ASSERT(grid(p) && dy);
-	if (!(grid(p) && dy))
+	JPS_ASSERT(g(p) && dy);
+	if (!(g(p) && dy))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 	const int cskip = this->skip;
 
@@ -789,7 +1601,7 @@ inline FPosition Searcher::jumpY(FPosition p, const int dy)
 	case DiagonalMovement::Always:
 		while (true)
 		{
-			if (p == finpos)
+			if (p == finpos || isTarget(p))
 			{
 				break;
 			}
@@ -803,21 +1615,21 @@ inline FPosition Searcher::jumpY(FPosition p, const int dy)
 			// forced
 			{
 				const int yy = y + dy;
-				if (grid(x + cskip, yy, z) && !grid(x + cskip, y, z) ||
-					grid(x - cskip, yy, z) && !grid(x - cskip, y, z) ||
-					grid(x, yy, z + cskip) && !grid(x, y, z + cskip) ||
-					grid(x, yy, z - cskip) && !grid(x, y, z - cskip) ||
-					grid(x + cskip, yy, z + cskip) && !grid(x + cskip, y, z + cskip) && !grid(x + cskip, y, z) && !grid(x, y, z + cskip) ||
-					grid(x - cskip, yy, z + cskip) && !grid(x - cskip, y, z + cskip) && !grid(x - cskip, y, z) && !grid(x, y, z + cskip) ||
-					grid(x + cskip, yy, z - cskip) && !grid(x + cskip, y, z - cskip) && !grid(x + cskip, y, z) && !grid(x, y, z - cskip) ||
-					grid(x - cskip, yy, z - cskip) && !grid(x - cskip, y, z - cskip) && !grid(x - cskip, y, z) && !grid(x, y, z - cskip))
+				if (g(x + cskip, yy, z) && !g(x + cskip, y, z) ||
+					g(x - cskip, yy, z) && !g(x - cskip, y, z) ||
+					g(x, yy, z + cskip) && !g(x, y, z + cskip) ||
+					g(x, yy, z - cskip) && !g(x, y, z - cskip) ||
+					g(x + cskip, yy, z + cskip) && !g(x + cskip, y, z + cskip) && !g(x + cskip, y, z) && !g(x, y, z + cskip) ||
+					g(x - cskip, yy, z + cskip) && !g(x - cskip, y, z + cskip) && !g(x - cskip, y, z) && !g(x, y, z + cskip) ||
+					g(x + cskip, yy, z - cskip) && !g(x + cskip, y, z - cskip) && !g(x + cskip, y, z) && !g(x, y, z - cskip) ||
+					g(x - cskip, yy, z - cskip) && !g(x - cskip, y, z - cskip) && !g(x - cskip, y, z) && !g(x, y, z - cskip))
 				{
 					break;
 				}
 			}
 			// !forced
 
-			if (grid(x, y + dy, z))
+			if (g(x, y + dy, z))
 			{
 				p.y += dy;
 			}
@@ -836,7 +1648,7 @@ inline FPosition Searcher::jumpY(FPosition p, const int dy)
 		/*
 		while (true)
 		{
-		if (p == finpos)
+		if (p == finpos || isTarget(p))
 		{
 		break;
 		}
@@ -855,20 +1667,21 @@ inline FPosition Searcher::jumpY(FPosition p, const int dy)
 		break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
 
-inline FPosition Searcher::jumpZ(FPosition p, const int dz)
+template <class TGrid>
+inline FPosition Searcher::jumpZ(const TGrid & g, FPosition p, const int dz)
 {
-	JPS_ASSERT(grid(p) && dz);
-	if (!(grid(p) && dz))
+	JPS_ASSERT(g(p) && dz);
+	if (!(g(p) && dz))
 	{
 		return InvalidPos;
 	}
 
-	const FPosition finpos = finishNode->pos;
+	const FPosition finpos = ctx.finishNode->pos;
 	unsigned steps = 0;
 	const int cskip = this->skip;
 
@@ -877,7 +1690,7 @@ inline FPosition Searcher::jumpZ(FPosition p, const int dz)
 	case DiagonalMovement::Always:
 		while (true)
 		{
-			if (p == finpos)
+			if (p == finpos || isTarget(p))
 			{
 				break;
 			}
@@ -891,21 +1704,21 @@ inline FPosition Searcher::jumpZ(FPosition p, const int dz)
 			// forced
 			{
 				const int zz = z + dz;
-				if (grid(x + cskip, y, zz) && !grid(x + cskip, y, z) ||
-					grid(x - cskip, y, zz) && !grid(x - cskip, y, z) ||
-					grid(x, y + cskip, zz) && !grid(x, y + cskip, z) ||
-					grid(x, y - cskip, zz) && !grid(x, y - cskip, z) ||
-					grid(x + cskip, y + cskip, zz) && !grid(x + cskip, y + cskip, z) && !grid(x + cskip, y, z) && !grid(x, y + cskip, z) ||
-					grid(x - cskip, y + cskip, zz) && !grid(x - cskip, y + cskip, z) && !grid(x - cskip, y, z) && !grid(x, y + cskip, z) ||
-					grid(x + cskip, y - cskip, zz) && !grid(x + cskip, y - cskip, z) && !grid(x + cskip, y, z) && !grid(x, y - cskip, z) ||
-					grid(x - cskip, y - cskip, zz) && !grid(x - cskip, y - cskip, z) && !grid(x - cskip, y, z) && !grid(x, y - cskip, z))
+				if (g(x + cskip, y, zz) && !g(x + cskip, y, z) ||
+					g(x - cskip, y, zz) && !g(x - cskip, y, z) ||
+					g(x, y + cskip, zz) && !g(x, y + cskip, z) ||
+					g(x, y - cskip, zz) && !g(x, y - cskip, z) ||
+					g(x + cskip, y + cskip, zz) && !g(x + cskip, y + cskip, z) && !g(x + cskip, y, z) && !g(x, y + cskip, z) ||
+					g(x - cskip, y + cskip, zz) && !g(x - cskip, y + cskip, z) && !g(x - cskip, y, z) && !g(x, y + cskip, z) ||
+					g(x + cskip, y - cskip, zz) && !g(x + cskip, y - cskip, z) && !g(x + cskip, y, z) && !g(x, y - cskip, z) ||
+					g(x - cskip, y - cskip, zz) && !g(x - cskip, y - cskip, z) && !g(x - cskip, y, z) && !g(x, y - cskip, z))
 				{
 					break;
 				}
 			}
 			// !forced
 
-			if (grid(x, y, z + dz))
+			if (g(x, y, z + dz))
 			{
 				p.z += dz;
 			}
@@ -924,7 +1737,7 @@ inline FPosition Searcher::jumpZ(FPosition p, const int dz)
 		/*
 		while (true)
 		{
-		if (p == finpos)
+		if (p == finpos || isTarget(p))
 		{
 		break;
 		}
@@ -943,7 +1756,7 @@ inline FPosition Searcher::jumpZ(FPosition p, const int dz)
 		break;
 	}
 
-	stepsTotal += steps;
+	ctx.stepsTotal += steps;
 
 	return p;
 }
@@ -971,32 +1784,98 @@ inline void Searcher::IdentifySuccessors(const Node * n)
 
 		Node * jn = getNode(jp);
 		JPS_ASSERT(jn && jn != n);
-		if (!jn || jn == n || jn->IsClosed())
+		if (!jn || jn == n || (jn->IsClosed() && !ctx.anytime))
 		{
 			continue;
 		}
 
-		unsigned curG = Euclidean(jn, n);
-		unsigned newG = n->G + curG;
+		// any-angle mode: the optimistic straight line from the parent of n, checked when jn is expanded
+		const Node * from = ctx.lazyTheta && n->anyParent ? n->anyParent : n;
+		// the anytime and the bidirectional modes count in the units of their heuristic, so it stays admissible
+		unsigned curG = ctx.anytime || ctx.bidirectional ? DirectionDistance(from->pos, jn->pos) : Euclidean(jn, from);
+		unsigned newG = from->G + curG;
+
+		if (jn->IsClosed())
+		{
+			// ARA*: keep the improvement for the next iteration
+			if (newG < jn->G)
+			{
+				jn->G = newG;
+				jn->F = jn->G + unsigned(weight * heuristic(jn));
+				jn->parent = n;
+				jn->SetIncons();
+			}
+			continue;
+		}
+
+		if (ctx.bidirectional && newG + DirectionDistance(jn->pos, ctx.finishNode->pos) >= ctx.meetCost)
+		{
+			// no path through jn is cheaper than the one the frontiers met on
+			continue;
+		}
 
 		if (!jn->IsOpen() || newG < jn->G)
 		{
 			jn->G = newG;
-			jn->F = jn->G + Manhattan(jn, finishNode);
+			jn->F = ctx.bidirectional ? 2U * jn->G + heuristic(jn) : jn->G + unsigned(weight * heuristic(jn));
 			jn->parent = n;
+			jn->anyParent = from;
+
+			if (ctx.bidirectional)
+			{
+				// the frontiers meet where a jump ends on a voxel the other direction has reached
+				const GridMap::const_iterator other = ctx.gridmapB.find(jn->pos);
+				if (other != ctx.gridmapB.end() && (other->second.IsOpen() || other->second.IsClosed()) &&
+					jn->G + other->second.G < ctx.meetCost)
+				{
+					ctx.meetCost = jn->G + other->second.G;
+					ctx.meet = jn->pos;
+				}
+			}
 
 			if (!jn->IsOpen())
 			{
 				jn->SetOpen();
-				openlist.push(jn);
+				ctx.openlist.push(jn);
+			}
+			else if (jn->IsStale())
+			{
+				jn->Reopen();
+				ctx.openlist.push(jn);
 			}
 			else
 			{
-				openlist.heapify();
+				ctx.openlist.heapify();
 			}
 		}
 	}
 }
+inline unsigned Searcher::Successors(const FPosition & p, const FPosition & Parent, const FPosition & Finish, FPosition * Out)
+{
+	// stand-in nodes: FindNeighbours only reads the parent position, the jumps only the finish
+	Node from(Parent);
+	Node cur(p);
+	Node fin(Finish);
+	cur.parent = Parent.IsValid() ? &from : NULL;
+	Node * const savedFinish = ctx.finishNode;
+	ctx.finishNode = &fin;
+
+	FPosition buf[26];
+	const unsigned cnt = FindNeighbours(&cur, &buf[0]);
+	unsigned n = 0U;
+	for (unsigned i = 0; i < cnt; ++i)
+	{
+		const FPosition jp = Jump(buf[i], p);
+		if (jp.IsValid() && jp != p)
+		{
+			Out[n++] = jp;
+		}
+	}
+
+	ctx.finishNode = savedFinish;
+	return n;
+}
+
 // partially ready
 inline unsigned Searcher::FindNeighbours(const Node * n, FPosition * Buf) const
 {
@@ -1822,15 +2701,22 @@ inline unsigned Searcher::FindNeighbours(const Node * n, FPosition * Buf) const
 	return unsigned(p - Buf);
 }
 // ready
+// the jumps are compiled once for the bare grid and once for the restricted view, so an unrestricted query pays nothing for the restrictions
 inline FPosition Searcher::Jump(const FPosition & Cur, const FPosition & Src)
 {
-	JPS_ASSERT(grid(Cur));
-	if (!grid(Cur))
+	return grid.IsRestricted() ? jump(grid, Cur, Src) : jump(grid.Base(), Cur, Src);
+}
+
+template <class TGrid>
+inline FPosition Searcher::jump(const TGrid & g, const FPosition & Cur, const FPosition & Src)
+{
+	JPS_ASSERT(g(Cur));
+	if (!g(Cur))
 	{
 		return InvalidPos;
 	}
 
-	if (Cur == finishNode->pos)
+	if (Cur == ctx.finishNode->pos || isTarget(Cur))
 	{
 		return Cur;
 	}
@@ -1847,31 +2733,31 @@ inline FPosition Searcher::Jump(const FPosition & Cur, const FPosition & Src)
 
 	if (dx && dy && dz)
 	{
-		return jumpXYZ(Cur, dx, dy, dz);
+		return jumpXYZ(g, Cur, dx, dy, dz);
 	}
 	else if (dx && dy)
 	{
-		return jumpXY(Cur, dx, dy);
+		return jumpXY(g, Cur, dx, dy);
 	}
 	else if (dx && dz)
 	{
-		return jumpXZ(Cur, dx, dz);
+		return jumpXZ(g, Cur, dx, dz);
 	}
 	else if (dy && dz)
 	{
-		return jumpYZ(Cur, dy, dz);
+		return jumpYZ(g, Cur, dy, dz);
 	}
 	else if (dx)
 	{
-		return jumpX(Cur, dx);
+		return jumpX(g, Cur, dx);
 	}
 	else if (dy)
 	{
-		return jumpY(Cur, dy);
+		return jumpY(g, Cur, dy);
 	}
 	else if (dz)
 	{
-		return jumpZ(Cur, dz);
+		return jumpZ(g, Cur, dz);
 	}
 	// must never reach this
 	JPS_ASSERT(false);
@@ -1880,8 +2766,8 @@ inline FPosition Searcher::Jump(const FPosition & Cur, const FPosition & Src)
 // ready
 inline PositionVector Searcher::BacktracePath(const Node * tail) const
 {
-	JPS_ASSERT(tail == finishNode);
-	if (tail != finishNode)
+	JPS_ASSERT(tail);
+	if (!tail)
 	{
 		return PositionVector();
 	}
@@ -1892,7 +2778,7 @@ inline PositionVector Searcher::BacktracePath(const Node * tail) const
 	{
 		JPS_ASSERT(tail != tail->parent);
 		path.push_back(tail->pos);
-		tail = tail->parent;
+		tail = ctx.lazyTheta ? tail->anyParent : tail->parent;
 	}
 	std::reverse(path.begin(), path.end());
 	return path;
@@ -1900,6 +2786,7 @@ inline PositionVector Searcher::BacktracePath(const Node * tail) const
 
 #pragma endregion
 
+#undef TargetSet
 #undef PositionVector
 #undef GridMap
 
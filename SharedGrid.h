@@ -0,0 +1,564 @@
+#ifndef SHARED_GRID_H
+#define SHARED_GRID_H
+
+#include <new>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "Grid.h"
+#include "Position.h"
+
+namespace JPS {
+
+	// the processes share the atomics of the header, which only works for the ones free of locks
+	static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the shared grid needs lock-free 32-bit atomics");
+
+	// the start of a segment; the creator writes every field before it sets ready, the atomics change afterwards
+	struct FSharedGridHeader
+	{
+		uint32_t magic;
+		uint32_t layout;
+		uint32_t cellBytes;
+		uint32_t x, y, z;
+		uint64_t bankBytes;
+		std::atomic<uint32_t> ready;
+		// the bank the readers pin, the version every bank holds and the pins every bank has
+		std::atomic<uint32_t> active;
+		std::atomic<uint32_t> version[2];
+		std::atomic<uint32_t> readers[2];
+	};
+
+	/*
+		A grid in a named shared-memory segment, a POSIX shm_open object or a named file mapping on Windows, that worker processes attach to
+		read-only, so every process searches the one copy of the map. The segment holds the grid twice: the readers pin the active bank,
+		the writer process brings the other one up to date once its last reader has left, with the edits of the two versions it lacks,
+		and swaps them (the left-right scheme), so a reader neither waits nor sees part of an update. The header records the layout,
+		so a process built against another one refuses the segment; a Searcher searches a pinned bank through SetGrid
+	*/
+	class SharedGrid
+	{
+
+	public:
+
+		// a pinned version, released by the destructor and before the grid is closed
+		class Snapshot
+		{
+
+		public:
+
+			Snapshot() {}
+
+			Snapshot(Snapshot && Other) : pins(Other.pins), grid(Other.grid), version(Other.version)
+			{
+				Other.pins = NULL;
+				Other.grid = NULL;
+			}
+
+			inline Snapshot & operator=(Snapshot && Other)
+			{
+				if (this != &Other)
+				{
+					Release();
+					std::swap(pins, Other.pins);
+					std::swap(grid, Other.grid);
+					version = Other.version;
+				}
+				return *this;
+			}
+
+			Snapshot(const Snapshot &) = delete;
+			Snapshot & operator=(const Snapshot &) = delete;
+
+			~Snapshot()
+			{
+				Release();
+			}
+
+			inline void Release()
+			{
+				if (pins)
+				{
+					pins->fetch_sub(1U);
+				}
+				pins = NULL;
+				grid = NULL;
+			}
+
+			inline explicit operator bool() const
+			{
+				return grid != NULL;
+			}
+
+			/*
+				The bank the snapshot pins; its lines point into the segment, so a copy of the grid shares them
+				and only stays unchanged while a snapshot of the same version is pinned. A copy that has to outlive the pin
+				is made with Detach
+			*/
+			inline const FGrid & Grid() const
+			{
+				return *grid;
+			}
+
+			// a grid with lines of its own and the voxels of the pinned version
+			inline FGrid Detach() const
+			{
+				FGrid g;
+				g.x = grid->x;
+				g.y = grid->y;
+				g.z = grid->z;
+				g.lines.assign(g.z, std::vector<int *>(g.y));
+				g.owners.assign(g.z, std::vector<std::shared_ptr<int>>(g.y));
+				for (unsigned i = 0; i < g.z; ++i)
+				{
+					for (unsigned j = 0; j < g.y; ++j)
+					{
+						g.owners[i][j] = g.newLine(grid->lines[i][j]);
+						g.lines[i][j] = g.owners[i][j].get();
+					}
+				}
+				return g;
+			}
+
+			// 1 for the grid the segment was created with, one more for every Publish
+			inline unsigned Version() const
+			{
+				return version;
+			}
+
+		private:
+
+			friend class SharedGrid;
+
+			std::atomic<uint32_t> * pins = NULL;
+			const FGrid * grid = NULL;
+			unsigned version = 0U;
+
+		};
+
+		SharedGrid() {}
+
+		~SharedGrid()
+		{
+			Close();
+		}
+
+		SharedGrid(const SharedGrid &) = delete;
+		SharedGrid & operator=(const SharedGrid &) = delete;
+
+		// creates the segment Name with the voxels of g and makes this process its writer; false if it exists or cannot be mapped
+		bool Create(const std::string & Name, const FGrid & g);
+
+		// attaches to the segment Name as a reader; false if it is missing, not created yet or of another layout
+		bool Open(const std::string & Name);
+
+		// detaches; the segment lives on until it is removed, and the copies of its grids keep it mapped, though not unchanged
+		void Close();
+
+		// removes the name, the processes attached keep the segment; a no-op on Windows, where the last process to close it frees it
+		static bool Remove(const std::string & Name);
+
+		inline bool IsOpen() const
+		{
+			return header != NULL;
+		}
+
+		inline bool IsWriter() const
+		{
+			return writer;
+		}
+
+		// the version the next Pin gets
+		inline unsigned GetVersion() const
+		{
+			return header ? header->version[header->active.load()].load() : 0U;
+		}
+
+		// never waits for the writer
+		Snapshot Pin();
+
+#pragma region Writer
+
+		// the edits stay invisible to the readers until Publish; only the process that created the segment edits it
+		inline void SetCell(unsigned xx, unsigned yy, unsigned zz, int value)
+		{
+			assert(writer);
+			if (writer && xx < header->x && yy < header->y && zz < header->z)
+			{
+				pending.push_back(std::make_pair((size_t(zz) * header->y + yy) * header->x + xx, value));
+			}
+		}
+
+		inline void SetCell(FPosition p, int value)
+		{
+			SetCell(p.x, p.y, p.z, value);
+		}
+
+		/*
+			Makes the edits the current version once the readers of the standby bank have left, waiting for them up to Wait;
+			false if they have not, or if this process is no writer, and the edits stay pending. A reader that dies pinned
+			holds its bank for good, so a writer that keeps failing has to create the segment anew
+		*/
+		bool Publish(std::chrono::milliseconds Wait = std::chrono::milliseconds(1000));
+
+		inline size_t GetPending() const
+		{
+			return pending.size();
+		}
+
+#pragma endregion
+
+		// "JPSG"
+		static const uint32_t Magic = 0x4753504AU;
+		// raised whenever the header or the banks change
+		static const uint32_t Layout = 1U;
+		// the banks start at a multiple of every page size and mapping granularity in use
+		static const size_t Alignment = 65536U;
+
+	private:
+
+		typedef std::pair<size_t, int> Edit;
+
+		FSharedGridHeader * header = NULL;
+		int * cells = NULL;
+		size_t bankCells = 0U;
+		// the views, held by the grids of the banks too
+		std::shared_ptr<void> headerView, dataView;
+		FGrid banks[2];
+		bool writer = false;
+		// the edits not published yet, and the published ones the standby bank lacks
+		std::vector<Edit> pending, behind;
+#if defined(_WIN32)
+		HANDLE handle = NULL;
+#else
+		int fd = -1;
+#endif
+
+		void bind();
+
+#pragma region Platform
+
+		bool openSegment(const std::string & Name, bool Create, size_t Bytes);
+		std::shared_ptr<void> mapView(size_t Offset, size_t Bytes, bool Writable) const;
+		// the size of the segment, UINT64_MAX where the system does not tell
+		uint64_t segmentBytes() const;
+		void closeSegment();
+
+#pragma endregion
+
+	};
+
+	inline bool SharedGrid::Create(const std::string & Name, const FGrid & g)
+	{
+		Close();
+		const size_t lineBytes = size_t(g.x) * sizeof(int);
+		const size_t bankBytes = std::max<size_t>(((size_t(g.y) * g.z * lineBytes + Alignment - 1U) / Alignment) * Alignment, Alignment);
+		if (!openSegment(Name, true, Alignment + 2U * bankBytes))
+		{
+			return false;
+		}
+		headerView = mapView(0U, Alignment, true);
+		dataView = mapView(Alignment, 2U * bankBytes, true);
+		if (!headerView || !dataView)
+		{
+			Close();
+			Remove(Name);
+			return false;
+		}
+
+		header = new (headerView.get()) FSharedGridHeader();
+		header->magic = Magic;
+		header->layout = Layout;
+		header->cellBytes = uint32_t(sizeof(int));
+		header->x = g.x;
+		header->y = g.y;
+		header->z = g.z;
+		header->bankBytes = bankBytes;
+		header->active = 0U;
+		header->version[0] = header->version[1] = 1U;
+		header->readers[0] = header->readers[1] = 0U;
+		cells = static_cast<int *>(dataView.get());
+		bankCells = bankBytes / sizeof(int);
+		for (unsigned b = 0; b < 2U; ++b)
+		{
+			for (unsigned i = 0; i < g.z; ++i)
+			{
+				for (unsigned j = 0; j < g.y; ++j)
+				{
+					memcpy(cells + b * bankCells + (size_t(i) * g.y + j) * g.x, g.lines[i][j], lineBytes);
+				}
+			}
+		}
+		writer = true;
+		bind();
+		// the readers take nothing above for granted before this
+		header->ready = 1U;
+		return true;
+	}
+
+	inline bool SharedGrid::Open(const std::string & Name)
+	{
+		Close();
+		if (!openSegment(Name, false, 0U))
+		{
+			return false;
+		}
+		// a segment still being sized by its creator is too small for the header
+		const uint64_t bytes = segmentBytes();
+		if (bytes < Alignment)
+		{
+			Close();
+			return false;
+		}
+		// the pins are counted in the header, so it is mapped writable; the banks are not
+		headerView = mapView(0U, Alignment, true);
+		header = static_cast<FSharedGridHeader *>(headerView.get());
+		if (!header || header->ready.load() != 1U || header->magic != Magic || header->layout != Layout || header->cellBytes != sizeof(int) ||
+			header->bankBytes < uint64_t(header->x) * header->y * header->z * sizeof(int) || bytes < Alignment + 2U * header->bankBytes)
+		{
+			Close();
+			return false;
+		}
+		dataView = mapView(Alignment, size_t(2U * header->bankBytes), false);
+		if (!dataView)
+		{
+			Close();
+			return false;
+		}
+		cells = static_cast<int *>(dataView.get());
+		bankCells = size_t(header->bankBytes / sizeof(int));
+		bind();
+		return true;
+	}
+
+	inline void SharedGrid::Close()
+	{
+		banks[0] = FGrid();
+		banks[1] = FGrid();
+		header = NULL;
+		cells = NULL;
+		headerView.reset();
+		dataView.reset();
+		writer = false;
+		pending.clear();
+		behind.clear();
+		closeSegment();
+	}
+
+	// the lines of the bank grids point into the view and hold it, so the writes through SetCell copy them first;
+	// a copy of a bank grid aliases the bank, which the writer rewrites once no snapshot pins it
+	inline void SharedGrid::bind()
+	{
+		for (unsigned b = 0; b < 2U; ++b)
+		{
+			FGrid & g = banks[b];
+			g.x = header->x;
+			g.y = header->y;
+			g.z = header->z;
+			g.lines.assign(g.z, std::vector<int *>(g.y));
+			g.owners.assign(g.z, std::vector<std::shared_ptr<int>>(g.y));
+			for (unsigned i = 0; i < g.z; ++i)
+			{
+				for (unsigned j = 0; j < g.y; ++j)
+				{
+					g.lines[i][j] = cells + b * bankCells + (size_t(i) * g.y + j) * g.x;
+					g.owners[i][j] = std::shared_ptr<int>(dataView, g.lines[i][j]);
+				}
+			}
+		}
+	}
+
+	inline SharedGrid::Snapshot SharedGrid::Pin()
+	{
+		Snapshot s;
+		if (!header)
+		{
+			return s;
+		}
+		unsigned b;
+		for (;;)
+		{
+			b = header->active.load();
+			header->readers[b].fetch_add(1U);
+			// the writer only writes a bank it found without pins after the swap, so a pin still on the active bank is safe
+			if (header->active.load() == b)
+			{
+				break;
+			}
+			header->readers[b].fetch_sub(1U);
+		}
+		s.pins = &header->readers[b];
+		s.grid = &banks[b];
+		s.version = header->version[b].load();
+		return s;
+	}
+
+	inline bool SharedGrid::Publish(std::chrono::milliseconds Wait)
+	{
+		if (!writer)
+		{
+			return false;
+		}
+		const unsigned standby = 1U - header->active.load();
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + Wait;
+		while (header->readers[standby].load())
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+
+		int * bank = cells + standby * bankCells;
+		for (size_t i = 0; i < behind.size(); ++i)
+		{
+			bank[behind[i].first] = behind[i].second;
+		}
+		for (size_t i = 0; i < pending.size(); ++i)
+		{
+			bank[pending[i].first] = pending[i].second;
+		}
+		header->version[standby] = header->version[1U - standby].load() + 1U;
+		header->active = standby;
+		// the bank just left lacks these until the next Publish
+		behind.swap(pending);
+		pending.clear();
+		return true;
+	}
+
+#pragma region Platform
+
+#if defined(_WIN32)
+
+	inline bool SharedGrid::openSegment(const std::string & Name, bool Create, size_t Bytes)
+	{
+		if (Create)
+		{
+			handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, DWORD(uint64_t(Bytes) >> 32), DWORD(uint64_t(Bytes) & 0xFFFFFFFFU), Name.c_str());
+			if (handle && GetLastError() == ERROR_ALREADY_EXISTS)
+			{
+				closeSegment();
+			}
+		}
+		else
+		{
+			handle = OpenFileMappingA(FILE_MAP_WRITE, FALSE, Name.c_str());
+		}
+		return handle != NULL;
+	}
+
+	inline std::shared_ptr<void> SharedGrid::mapView(size_t Offset, size_t Bytes, bool Writable) const
+	{
+		void * p = MapViewOfFile(handle, Writable ? FILE_MAP_WRITE : FILE_MAP_READ, DWORD(uint64_t(Offset) >> 32), DWORD(uint64_t(Offset) & 0xFFFFFFFFU), Bytes);
+		if (!p)
+		{
+			return std::shared_ptr<void>();
+		}
+		return std::shared_ptr<void>(p, [](void * v) { UnmapViewOfFile(v); });
+	}
+
+	inline uint64_t SharedGrid::segmentBytes() const
+	{
+		return UINT64_MAX;
+	}
+
+	inline void SharedGrid::closeSegment()
+	{
+		if (handle)
+		{
+			CloseHandle(handle);
+		}
+		handle = NULL;
+	}
+
+	inline bool SharedGrid::Remove(const std::string &)
+	{
+		return true;
+	}
+
+#else
+
+	// the POSIX names start with a slash
+	inline std::string SharedGridName(const std::string & Name)
+	{
+		return !Name.empty() && Name[0] == '/' ? Name : "/" + Name;
+	}
+
+	inline bool SharedGrid::openSegment(const std::string & Name, bool Create, size_t Bytes)
+	{
+		fd = shm_open(SharedGridName(Name).c_str(), Create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+		if (fd < 0)
+		{
+			return false;
+		}
+		if (Create && ftruncate(fd, off_t(Bytes)) != 0)
+		{
+			closeSegment();
+			Remove(Name);
+			return false;
+		}
+		return true;
+	}
+
+	inline std::shared_ptr<void> SharedGrid::mapView(size_t Offset, size_t Bytes, bool Writable) const
+	{
+		void * p = mmap(NULL, Bytes, Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, off_t(Offset));
+		if (p == MAP_FAILED)
+		{
+			return std::shared_ptr<void>();
+		}
+		return std::shared_ptr<void>(p, [Bytes](void * v) { munmap(v, Bytes); });
+	}
+
+	inline uint64_t SharedGrid::segmentBytes() const
+	{
+		struct stat st;
+		return fstat(fd, &st) == 0 ? uint64_t(st.st_size) : 0U;
+	}
+
+	inline void SharedGrid::closeSegment()
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		fd = -1;
+	}
+
+	inline bool SharedGrid::Remove(const std::string & Name)
+	{
+		return shm_unlink(SharedGridName(Name).c_str()) == 0;
+	}
+
+#endif
+
+#pragma endregion
+
+}
+
+#endif // !SHARED_GRID_H
\ No newline at end of file